@@ -0,0 +1,255 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef BUDDYBITMAP_H
+#define BUDDYBITMAP_H
+
+#include "types.h"
+#include "cmp_int.h"
+
+inline size_t BUDDY_ERR_IDX = -1;
+
+/*
+ * Binary buddy allocator over a range of equally sized units (e.g. physical frames).
+ *
+ * Level k holds one bit per naturally aligned block of 2^k units, set when that whole block is free and its
+ * buddy is not (otherwise the pair would have been merged into level k+1). Nothing is stored in the units
+ * themselves so this works for memory which is not mapped. Allocation and free are O(max_order) bit operations
+ * plus a forward search of one level which starts at that level's lowest possibly free block.
+ */
+template <size_t max_order>
+class BuddyBitmap
+{
+public:
+    /** Number of u64 words init needs for total_units units. */
+    static constexpr size_t storage_words(const size_t total_units)
+    {
+        size_t words = 0;
+        for (size_t k = 0; k <= max_order; k++)
+        {
+            words += ((total_units >> k) + 63) / 64;
+        }
+        return words;
+    }
+
+    /* late init: every unit starts allocated. Use free_range to add usable memory. */
+    void init(u64* storage, const size_t total_units)
+    {
+        n_units = total_units;
+        free_units = 0;
+        for (size_t k = 0; k <= max_order; k++)
+        {
+            const size_t n_words = ((total_units >> k) + 63) / 64;
+            levels[k] = storage;
+            for (size_t i = 0; i < n_words; i++) storage[i] = 0;
+            hints[k] = total_units >> k;
+            storage += n_words;
+        }
+    }
+
+    /**
+     * Allocate one naturally aligned block of 2^order units.
+     * @param order log2 of the number of units
+     * @return index of the first unit or BUDDY_ERR_IDX if there is no free block large enough.
+     */
+    size_t alloc(const size_t order)
+    {
+        if (order > max_order) return BUDDY_ERR_IDX;
+        size_t k = order;
+        size_t block = BUDDY_ERR_IDX;
+        for (; k <= max_order; k++)
+        {
+            block = find_free(k);
+            if (block != BUDDY_ERR_IDX) break;
+        }
+        if (block == BUDDY_ERR_IDX) return BUDDY_ERR_IDX;
+
+        clear_bit(k, block);
+        while (k > order) // split, keeping the lower half and freeing the upper half each time
+        {
+            k--;
+            block <<= 1;
+            mark_free(k, block + 1);
+        }
+        free_units -= size_t{1} << order;
+        return block << order;
+    }
+
+    /**
+     * Allocate n contiguous units. The run starts on a 2^ceil(log2(n)) boundary and any tail beyond n is returned.
+     * @param n number of units, at most 2^max_order
+     * @return index of the first unit or BUDDY_ERR_IDX
+     */
+    size_t alloc_run(const size_t n)
+    {
+        if (n == 0) return BUDDY_ERR_IDX;
+        const size_t order = order_for(n);
+        const size_t unit = alloc(order);
+        if (unit == BUDDY_ERR_IDX) return BUDDY_ERR_IDX;
+        free_range(unit + n, (size_t{1} << order) - n);
+        return unit;
+    }
+
+    /**
+     * Return a block previously obtained from alloc and merge it with its free buddies.
+     * @return false if the block is out of range, misaligned or already free.
+     */
+    bool free(const size_t unit, const size_t order)
+    {
+        if (order > max_order || unit >= n_units || (size_t{1} << order) > n_units - unit) return false;
+        if (unit & ((size_t{1} << order) - 1)) return false;
+        if (free_order(unit) != BUDDY_ERR_IDX) return false;
+
+        size_t block = unit >> order;
+        size_t k = order;
+        for (; k < max_order; k++)
+        {
+            const size_t buddy = block ^ 1;
+            if (buddy >= (n_units >> k) || !get_bit(k, buddy)) break;
+            clear_bit(k, buddy);
+            block >>= 1;
+        }
+        mark_free(k, block);
+        free_units += size_t{1} << order;
+        return true;
+    }
+
+    /** Free n units starting at unit as the largest aligned blocks that fit. Units which are already free are skipped. */
+    void free_range(size_t unit, const size_t n)
+    {
+        const size_t end = n > n_units - MIN(unit, n_units) ? n_units : unit + n;
+        while (unit < end)
+        {
+            size_t k = 0;
+            while (k < max_order && (unit & ((size_t{2} << k) - 1)) == 0 && unit + (size_t{2} << k) <= end) k++;
+            if (k > 0 && contains_free(unit, k)) // partly free already, fall back to single units
+            {
+                for (size_t i = 0; i < (size_t{1} << k); i++) free(unit + i, 0);
+            }
+            else
+            {
+                free(unit, k);
+            }
+            unit += size_t{1} << k;
+        }
+    }
+
+    /**
+     * Take a specific unit out of the free pool, e.g. because it is being mapped directly.
+     * @return false if the unit was not free.
+     */
+    bool reserve(const size_t unit)
+    {
+        size_t k = free_order(unit);
+        if (k == BUDDY_ERR_IDX) return false;
+        clear_bit(k, unit >> k);
+        while (k > 0) // split down to the unit, freeing the half which does not contain it each time
+        {
+            k--;
+            mark_free(k, (unit >> k) ^ 1);
+        }
+        free_units--;
+        return true;
+    }
+
+    /** @return true if unit is currently free */
+    bool is_free(const size_t unit) const { return free_order(unit) != BUDDY_ERR_IDX; }
+
+    size_t get_free_units() const { return free_units; }
+
+    size_t get_total_units() const { return n_units; }
+
+    /** @return smallest order whose blocks hold at least n units */
+    static size_t order_for(const size_t n)
+    {
+        size_t order = 0;
+        while ((size_t{1} << order) < n) order++;
+        return order;
+    }
+
+private:
+    /* order of the free block containing unit, or BUDDY_ERR_IDX if unit is allocated */
+    size_t free_order(const size_t unit) const
+    {
+        for (size_t k = 0; k <= max_order; k++)
+        {
+            const size_t block = unit >> k;
+            if (block >= (n_units >> k)) break;
+            if (get_bit(k, block)) return k;
+        }
+        return BUDDY_ERR_IDX;
+    }
+
+    /* true if any block below order inside the block of 2^order units starting at unit is free */
+    bool contains_free(const size_t unit, const size_t order) const
+    {
+        for (size_t k = 0; k < order; k++)
+        {
+            for (size_t block = unit >> k; block < (unit + (size_t{1} << order)) >> k; block++)
+            {
+                if (get_bit(k, block)) return true;
+            }
+        }
+        return false;
+    }
+
+    size_t find_free(const size_t k)
+    {
+        const size_t n_blocks = n_units >> k;
+        size_t word = hints[k] / 64;
+        const size_t n_words = (n_blocks + 63) / 64;
+        if (hints[k] >= n_blocks) return BUDDY_ERR_IDX;
+        u64 data = levels[k][word] & (~u64{0} << (hints[k] % 64));
+        while (data == 0)
+        {
+            if (++word >= n_words)
+            {
+                hints[k] = n_blocks;
+                return BUDDY_ERR_IDX;
+            }
+            data = levels[k][word];
+        }
+        hints[k] = word * 64 + __builtin_ctzll(data);
+        return hints[k];
+    }
+
+    void mark_free(const size_t k, const size_t block)
+    {
+        levels[k][block / 64] |= u64{1} << (block % 64);
+        if (block < hints[k]) hints[k] = block;
+    }
+
+    void clear_bit(const size_t k, const size_t block)
+    {
+        levels[k][block / 64] &= ~(u64{1} << (block % 64));
+    }
+
+    bool get_bit(const size_t k, const size_t block) const
+    {
+        return levels[k][block / 64] >> (block % 64) & 1;
+    }
+
+    u64* levels[max_order + 1]{};
+    size_t hints[max_order + 1]{}; // lowest block index on each level which may be free
+    size_t n_units = 0;
+    size_t free_units = 0;
+};
+
+#endif //BUDDYBITMAP_H
@@ -0,0 +1,73 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef TRACERING_H
+#define TRACERING_H
+
+#include "types.h"
+
+/*
+ * Fixed capacity ring of the most recent items, for tracing. There is one writer, which never blocks and overwrites the
+ * oldest item once full. Readers copy a snapshot without any lock and drop whatever the writer lapped while they were
+ * copying. The writer must not be re-entered, e.g. only push with interrupts disabled.
+ */
+template <typename T, size_t capacity>
+class TraceRing
+{
+    static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+    void push(const T& item)
+    {
+        const size_t idx = __atomic_load_n(&head, __ATOMIC_RELAXED);
+        items[idx & (capacity - 1)] = item;
+        __atomic_store_n(&head, idx + 1, __ATOMIC_RELEASE);
+    }
+
+    /**
+     * Copy up to max_items of the newest items into dest, oldest first.
+     * @return number of items copied
+     */
+    size_t read_latest(T* dest, const size_t max_items) const
+    {
+        const size_t end = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        size_t n = end < capacity ? end : capacity;
+        if (n > max_items) n = max_items;
+        const size_t start = end - n;
+        for (size_t i = 0; i < n; i++) dest[i] = items[(start + i) & (capacity - 1)];
+
+        // Anything older than the last capacity items may have been overwritten part way through the copy.
+        const size_t now = __atomic_load_n(&head, __ATOMIC_ACQUIRE);
+        const size_t oldest_valid = now > capacity ? now - capacity : 0;
+        if (oldest_valid <= start) return n;
+        const size_t lost = oldest_valid - start < n ? oldest_valid - start : n;
+        for (size_t i = lost; i < n; i++) dest[i - lost] = dest[i];
+        return n - lost;
+    }
+
+    /** Number of items ever pushed, including those which have since been overwritten. */
+    size_t total() const { return __atomic_load_n(&head, __ATOMIC_ACQUIRE); }
+
+private:
+    T items[capacity]{};
+    size_t head = 0; // index the next item goes to, never wrapped to the capacity
+};
+
+#endif //TRACERING_H
@@ -0,0 +1,224 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef LRUINDEX_H
+#define LRUINDEX_H
+
+#include "types.h"
+
+inline size_t LRU_ERR_IDX = -1;
+
+/*
+ * Maps u64 keys to a fixed number of slots and recycles the least recently used slot once every slot is taken. The
+ * caller owns whatever the slots refer to, e.g. equally sized chunks of one buffer. Slots are chained into hash buckets
+ * for lookup and into one list from most to least recently used, so find, insert and erase are O(1). A pinned slot
+ * is taken off that list so it cannot be evicted. Nothing is allocated: init is given storage_bytes of memory.
+ */
+class LRUIndex
+{
+    static constexpr u32 none = ~u32{0};
+
+    struct slot_t
+    {
+        u64 key;
+        u32 newer; // towards the most recently used end
+        u32 older;
+        u32 chain; // next slot in the same bucket
+        bool used;
+        bool pinned; // not on the recently used list
+    };
+
+public:
+    static constexpr size_t n_buckets_for(const size_t n_slots)
+    {
+        size_t n = 1;
+        while (n < n_slots) n <<= 1;
+        return n;
+    }
+
+    /** Bytes init needs for n_slots slots. */
+    static constexpr size_t storage_bytes(const size_t n_slots)
+    {
+        return n_slots * sizeof(slot_t) + n_buckets_for(n_slots) * sizeof(u32);
+    }
+
+    /* late init: every slot starts unused. storage must be aligned for u64. */
+    void init(void* storage, const size_t n_slots)
+    {
+        slots = static_cast<slot_t*>(storage);
+        buckets = reinterpret_cast<u32*>(slots + n_slots);
+        n_total = n_slots;
+        bucket_mask = n_buckets_for(n_slots) - 1;
+        for (size_t i = 0; i <= bucket_mask; i++) buckets[i] = none;
+        n_used = 0;
+        // Unused slots sit at the least recently used end so that they are handed out before anything is evicted.
+        newest = none;
+        oldest = none;
+        for (size_t i = 0; i < n_slots; i++)
+        {
+            slots[i] = slot_t{0, none, none, none, false, false};
+            push_oldest(i);
+        }
+    }
+
+    /**
+     * Look up key and mark it as the most recently used.
+     * @return slot holding key or LRU_ERR_IDX
+     */
+    size_t find(const u64 key)
+    {
+        const size_t slot = peek(key);
+        if (slot == LRU_ERR_IDX || slots[slot].pinned) return slot;
+        unlink(slot);
+        push_newest(slot);
+        return slot;
+    }
+
+    /** Look up key without changing the order. */
+    size_t peek(const u64 key) const
+    {
+        for (u32 slot = buckets[bucket_of(key)]; slot != none; slot = slots[slot].chain)
+        {
+            if (slots[slot].key == key) return slot;
+        }
+        return LRU_ERR_IDX;
+    }
+
+    /**
+     * Give key a slot, as the most recently used. An unused slot is taken first, otherwise the least recently used key
+     * which is not pinned is evicted. A key which is already present keeps its slot.
+     * @param evicted set to true if another key lost its slot, may be null
+     * @return slot for key or LRU_ERR_IDX if every slot is pinned
+     */
+    size_t insert(const u64 key, bool* evicted = nullptr)
+    {
+        if (evicted) *evicted = false;
+        if (const size_t existing = find(key); existing != LRU_ERR_IDX) return existing;
+        if (oldest == none) return LRU_ERR_IDX;
+
+        const u32 slot = oldest;
+        if (slots[slot].used)
+        {
+            unchain(slot);
+            if (evicted) *evicted = true;
+        }
+        else
+        {
+            n_used++;
+        }
+        slots[slot].key = key;
+        slots[slot].used = true;
+        const size_t bucket = bucket_of(key);
+        slots[slot].chain = buckets[bucket];
+        buckets[bucket] = slot;
+        unlink(slot);
+        push_newest(slot);
+        return slot;
+    }
+
+    /** Forget whatever key slot holds and make it the next to be reused. A pinned slot is unpinned. */
+    void erase(const size_t slot)
+    {
+        if (slot >= n_total || !slots[slot].used) return;
+        unchain(slot);
+        slots[slot].used = false;
+        n_used--;
+        if (slots[slot].pinned) slots[slot].pinned = false;
+        else unlink(slot);
+        push_oldest(slot);
+    }
+
+    /** Keep a used slot from being evicted, e.g. while the data it refers to is being filled. It can still be found. */
+    void pin(const size_t slot)
+    {
+        if (slot >= n_total || !slots[slot].used || slots[slot].pinned) return;
+        unlink(slot);
+        slots[slot].pinned = true;
+    }
+
+    /** Make a pinned slot evictable again, as the most recently used. */
+    void unpin(const size_t slot)
+    {
+        if (slot >= n_total || !slots[slot].pinned) return;
+        slots[slot].pinned = false;
+        push_newest(slot);
+    }
+
+    bool is_pinned(const size_t slot) const { return slot < n_total && slots[slot].pinned; }
+
+    u64 key_of(const size_t slot) const { return slots[slot].key; }
+
+    size_t get_used() const { return n_used; }
+
+    size_t get_capacity() const { return n_total; }
+
+private:
+    size_t bucket_of(const u64 key) const
+    {
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> 32) & bucket_mask;
+    }
+
+    void unchain(const u32 slot)
+    {
+        u32* link = &buckets[bucket_of(slots[slot].key)];
+        while (*link != slot) link = &slots[*link].chain;
+        *link = slots[slot].chain;
+        slots[slot].chain = none;
+    }
+
+    void unlink(const u32 slot)
+    {
+        slot_t& s = slots[slot];
+        if (s.newer != none) slots[s.newer].older = s.older;
+        else newest = s.older;
+        if (s.older != none) slots[s.older].newer = s.newer;
+        else oldest = s.newer;
+        s.newer = none;
+        s.older = none;
+    }
+
+    void push_newest(const u32 slot)
+    {
+        slots[slot].older = newest;
+        slots[slot].newer = none;
+        if (newest != none) slots[newest].newer = slot;
+        else oldest = slot;
+        newest = slot;
+    }
+
+    void push_oldest(const u32 slot)
+    {
+        slots[slot].newer = oldest;
+        slots[slot].older = none;
+        if (oldest != none) slots[oldest].older = slot;
+        else newest = slot;
+        oldest = slot;
+    }
+
+    slot_t* slots = nullptr;
+    u32* buckets = nullptr;
+    size_t n_total = 0;
+    size_t n_used = 0;
+    size_t bucket_mask = 0;
+    u32 newest = none;
+    u32 oldest = none;
+};
+
+#endif //LRUINDEX_H
@@ -22,6 +22,7 @@
 #define DENSEBOOLEANARRAY_H
 
 #include "types.h"
+#include "cmp_int.h"
 
 // TODO: create expand and shrink functionality?
 
@@ -73,6 +74,34 @@ public:
         }
     }
 
+    /** u64 words needed by init_summary for a map of total_bits bits */
+    static constexpr size_t summary_words(const size_t total_bits)
+    {
+        const size_t n_items = (total_bits + sizeof(int_like) * 8 - 1) / (sizeof(int_like) * 8);
+        return 2 * ((n_items + 63) / 64);
+    }
+
+    /*
+     * Optional second level: one bit per item which is all ones and one bit per item which is all zeros. Searches
+     * use these to skip whole runs of items which cannot contain a match. storage must hold summary_words(capacity)
+     * words and the summary is built from the current contents.
+     */
+    void init_summary(u64* storage)
+    {
+        const size_t n_summary = (array_len + 63) / 64;
+        summary_full = storage;
+        summary_empty = storage + n_summary;
+        for (size_t i = 0; i < n_summary; i++)
+        {
+            summary_full[i] = 0;
+            summary_empty[i] = 0;
+        }
+        for (size_t i = 0; i < array_len; i++)
+        {
+            update_summary(i);
+        }
+    }
+
     bool operator [](const size_t bit_idx)
     {
         if (bit_idx >= capacity) return false;
@@ -93,6 +122,7 @@ public:
         {
             array[array_idx] &= ~(v << (bit_idx));
         }
+        update_summary(array_idx);
     }
 
 
@@ -104,26 +134,7 @@ public:
     // Exact same logic as get_next_true but all the data is inverted.
     size_t get_next_false(const size_t offset)
     {
-        size_t array_idx = offset / n_bits;
-        size_t item_idx = offset % n_bits;
-        constexpr int_like v = -1;
-        int_like mask = v << item_idx; // returns, e.g. 11111000 if item_idx == 3
-        int_like data = ~array[array_idx] & mask; // ignores lowest bits
-        item_idx = 0;
-
-        while (data == 0 && array_idx < array_len) // while data is all ones (no falses in int_like)
-        {
-            array_idx++;
-            data = ~array[array_idx];
-        }
-
-        for (constexpr int_like vv = 1; !(data & vv << item_idx) && item_idx <= n_bits; item_idx++)
-        {
-        } // bit wise
-
-        item_idx = array_idx * n_bits + item_idx;
-        if (item_idx >= capacity) return DBA_ERR_IDX; // possible if last entry is not full
-        return item_idx;
+        return find_next(offset, false);
     }
 
 
@@ -149,31 +160,13 @@ public:
 
     size_t get_next_true(const size_t offset)
     {
-        size_t array_idx = offset / n_bits;
-        size_t item_idx = offset % n_bits;
-        constexpr int_like v = -1;
-        int_like mask = v << item_idx;
-        int_like data = array[array_idx] & mask; // ignores lowest bits
-        item_idx = 0;
-
-        while (data == 0 && array_idx < array_len) // while data is all zeros (no trues in int_like)
-        {
-            array_idx++;
-            data = array[array_idx];
-        }
-
-        for (int_like vv = 1; !(data & vv << item_idx) && item_idx <= n_bits; item_idx++)
-        {
-        } // bitwise search within.
-
-        item_idx = array_idx * n_bits + item_idx;
-        if (item_idx >= capacity) return DBA_ERR_IDX; // possible if last entry is not full
-        return item_idx;
+        return find_next(offset, true);
     }
 
     // gets start idx of a contiguous chunk of trues with length at least as large as n.
     size_t get_next_trues(const size_t offset, size_t n)
     {
+        if (summary_full != nullptr && n >= 2 * n_bits) return find_long_run(offset, n);
         size_t start_idx = get_next_true(offset);
         size_t next_idx = get_next_false(start_idx);
         while (next_idx - start_idx < n && start_idx < DBA_ERR_IDX && next_idx < DBA_ERR_IDX)
@@ -198,10 +191,12 @@ public:
         {
             set_bit(bit, b);
         }
-        for (; bit + n_bits < end; bit += n_bits) // set all whole chunks
+        const size_t first_whole = bit / n_bits;
+        for (; bit + n_bits <= end; bit += n_bits) // set all whole chunks
         {
             array[bit / n_bits] = mask;
         }
+        set_summary_range(first_whole, bit / n_bits, b);
         for (; bit < end; bit++) // set remaining bits
         {
             set_bit(bit, b);
@@ -219,17 +214,135 @@ public:
     void set_all(bool b)
     {
         const int_like v = get_mask(b);
-        for (int i = 0; i < array_len; i++)
+        for (size_t i = 0; i < array_len; i++)
         {
             array[i] = v;
+            update_summary(i);
         }
     }
 
 private:
+    static constexpr size_t item_bits = sizeof(int_like) * 8;
+
+    /* Item as unsigned bits, without sign extension of narrower signed types. */
+    static u64 item_as_bits(const int_like item)
+    {
+        if constexpr (item_bits == 64) return static_cast<u64>(item);
+        else return static_cast<u64>(item) & ((u64{1} << item_bits) - 1);
+    }
+
+    static u64 item_mask_from(const size_t bit_idx)
+    {
+        return item_as_bits(static_cast<int_like>(~int_like{0})) & (~u64{0} << bit_idx);
+    }
+
+    void update_summary(const size_t array_idx)
+    {
+        if (summary_full == nullptr) return;
+        const u64 bit = u64{1} << (array_idx % 64);
+        const u64 item = item_as_bits(array[array_idx]);
+        if (item == item_mask_from(0)) summary_full[array_idx / 64] |= bit;
+        else summary_full[array_idx / 64] &= ~bit;
+        if (item == 0) summary_empty[array_idx / 64] |= bit;
+        else summary_empty[array_idx / 64] &= ~bit;
+    }
+
+    /* Index of the first item at or after array_idx which has at least one bit equal to b, or array_len. */
+    size_t next_candidate_item(size_t array_idx, const bool b)
+    {
+        if (summary_full == nullptr)
+        {
+            const int_like skip = get_mask(!b);
+            while (array_idx < array_len && array[array_idx] == skip) array_idx++;
+            return array_idx;
+        }
+        // An item can contain a b unless it is entirely !b
+        const u64* skip_summary = b ? summary_empty : summary_full;
+        const size_t n_summary = (array_len + 63) / 64;
+        size_t summary_idx = array_idx / 64;
+        if (summary_idx >= n_summary) return array_len;
+        u64 candidates = ~skip_summary[summary_idx] & (~u64{0} << (array_idx % 64));
+        while (candidates == 0)
+        {
+            if (++summary_idx >= n_summary) return array_len;
+            candidates = ~skip_summary[summary_idx];
+        }
+        return MIN(summary_idx * 64 + __builtin_ctzll(candidates), array_len);
+    }
+
+    void set_summary_range(size_t first_item, const size_t end_item, const bool b)
+    {
+        if (summary_full == nullptr) return;
+        for (; first_item < end_item && first_item % 64 != 0; first_item++) update_summary(first_item);
+        for (; first_item + 64 <= end_item; first_item += 64)
+        {
+            summary_full[first_item / 64] = b ? ~u64{0} : 0;
+            summary_empty[first_item / 64] = b ? 0 : ~u64{0};
+        }
+        for (; first_item < end_item; first_item++) update_summary(first_item);
+    }
+
+    /*
+     * A run of at least 2 * n_bits trues must contain a whole item of trues, so only runs around items marked full
+     * in the summary need to be measured. Each is extended backwards with clz and forwards with get_next_false.
+     */
+    size_t find_long_run(const size_t offset, const size_t n)
+    {
+        const size_t n_summary = (array_len + 63) / 64;
+        size_t item = (offset + n_bits - 1) / n_bits;
+        while (item < array_len)
+        {
+            size_t summary_idx = item / 64;
+            u64 candidates = summary_full[summary_idx] & (~u64{0} << (item % 64));
+            while (candidates == 0)
+            {
+                if (++summary_idx >= n_summary) return DBA_ERR_IDX;
+                candidates = summary_full[summary_idx];
+            }
+            item = summary_idx * 64 + __builtin_ctzll(candidates);
+            if (item >= array_len) return DBA_ERR_IDX;
+
+            size_t run_start = item * n_bits;
+            if (item > 0)
+            {
+                // leading ones of the previous item continue the run
+                const u64 prev_zeros = item_as_bits(~array[item - 1]) << (64 - item_bits);
+                run_start -= prev_zeros == 0 ? n_bits : __builtin_clzll(prev_zeros);
+            }
+            run_start = MAX(run_start, offset);
+
+            size_t run_end = get_next_false(item * n_bits);
+            if (run_end == DBA_ERR_IDX) run_end = capacity;
+            if (run_end - run_start >= n) return run_start;
+            item = run_end / n_bits + 1;
+        }
+        return DBA_ERR_IDX;
+    }
+
+    /* Shared search for get_next_true and get_next_false. */
+    size_t find_next(const size_t offset, const bool b)
+    {
+        if (offset >= capacity) return DBA_ERR_IDX;
+        size_t array_idx = offset / n_bits;
+        u64 data = item_as_bits(b ? array[array_idx] : ~array[array_idx]) & item_mask_from(offset % n_bits);
+        if (data == 0)
+        {
+            array_idx = next_candidate_item(array_idx + 1, b);
+            if (array_idx >= array_len) return DBA_ERR_IDX;
+            data = item_as_bits(b ? array[array_idx] : ~array[array_idx]);
+        }
+        const size_t idx = array_idx * n_bits + __builtin_ctzll(data);
+        if (idx >= capacity) return DBA_ERR_IDX; // possible if last entry is not full
+        return idx;
+    }
+
+
     int_like* array;
     size_t array_len = 0; // n_items in array
     size_t capacity = 0; // bits
     size_t n_bits = 0;
+    u64* summary_full = nullptr;
+    u64* summary_empty = nullptr;
 };
 
 
@@ -0,0 +1,114 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef MINHEAP_H
+#define MINHEAP_H
+
+#include "types.h"
+
+/*
+ * Fixed capacity binary min-heap ordered by T's operator<. Storage is inline so it needs no allocator, which makes it
+ * usable from interrupt handlers. push and pop are O(log n), top is O(1).
+ */
+template <typename T, size_t capacity>
+class MinHeap
+{
+public:
+    /** @return false if the heap is full */
+    bool push(const T& item)
+    {
+        if (n_items >= capacity) return false;
+        items[n_items] = item;
+        sift_up(n_items++);
+        return true;
+    }
+
+    /** Smallest item. Only valid when not empty. */
+    const T& top() const { return items[0]; }
+
+    /** Remove the smallest item. Does nothing when empty. */
+    void pop()
+    {
+        if (n_items == 0) return;
+        items[0] = items[--n_items];
+        sift_down(0);
+    }
+
+    /**
+     * Remove every item matching pred. O(n).
+     * @return number of items removed
+     */
+    template <typename Pred>
+    size_t remove_if(Pred pred)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < n_items; i++)
+        {
+            if (!pred(items[i])) items[kept++] = items[i];
+        }
+        const size_t removed = n_items - kept;
+        n_items = kept;
+        for (size_t i = n_items / 2; i > 0; i--) sift_down(i - 1);
+        return removed;
+    }
+
+    size_t size() const { return n_items; }
+
+    bool empty() const { return n_items == 0; }
+
+private:
+    void sift_up(size_t idx)
+    {
+        while (idx > 0)
+        {
+            const size_t parent = (idx - 1) / 2;
+            if (!(items[idx] < items[parent])) return;
+            swap(idx, parent);
+            idx = parent;
+        }
+    }
+
+    void sift_down(size_t idx)
+    {
+        while (true)
+        {
+            const size_t left = 2 * idx + 1;
+            const size_t right = left + 1;
+            size_t smallest = idx;
+            if (left < n_items && items[left] < items[smallest]) smallest = left;
+            if (right < n_items && items[right] < items[smallest]) smallest = right;
+            if (smallest == idx) return;
+            swap(idx, smallest);
+            idx = smallest;
+        }
+    }
+
+    void swap(const size_t a, const size_t b)
+    {
+        const T tmp = items[a];
+        items[a] = items[b];
+        items[b] = tmp;
+    }
+
+    T items[capacity]{};
+    size_t n_items = 0;
+};
+
+#endif //MINHEAP_H
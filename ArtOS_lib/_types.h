@@ -33,5 +33,6 @@ typedef signed long long i64;
 
 typedef u32 size_t;
 typedef u32 uintptr_t;
+typedef i32 intptr_t;
 
 #endif //_TYPES_H
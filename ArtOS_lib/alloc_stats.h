@@ -0,0 +1,50 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef ALLOC_STATS_H
+#define ALLOC_STATS_H
+
+#define ALLOC_STATS_N_SLAB_CLASSES 8 // 16 to 2048 bytes in powers of two
+
+// Kernel heap and page pool counters, filled in by the GET_ALLOC_STATS syscall.
+struct alloc_stats_t
+{
+    unsigned long slab_allocs[ALLOC_STATS_N_SLAB_CLASSES];
+    unsigned long slab_frees[ALLOC_STATS_N_SLAB_CLASSES];
+    unsigned long slab_pages; // pages carved into slab objects, these are never returned
+    unsigned long chunk_allocs;
+    unsigned long chunk_frees;
+    unsigned long bytes_live; // bytes handed out and not yet freed, including rounding
+    unsigned long bytes_peak;
+    unsigned long chunks_in_use; // entries of the chunk array in use
+    unsigned long chunk_array_capacity;
+    unsigned long chunk_array_expansions;
+    unsigned long pages_mapped; // total pages taken from kmmap by the allocator
+    unsigned long pages_unmapped; // total pages given back with kmunmap
+    unsigned long search_samples; // chunk searches which were timed
+    unsigned long long search_ticks; // TSC ticks spent in the timed searches
+    unsigned long zero_pool_hits; // pages mmap took already cleared from the idle task's pool
+    unsigned long zero_pool_misses; // pages mmap had to clear itself
+    unsigned long zero_pool_frames; // frames currently in the pool
+    unsigned long zero_pool_capacity;
+    unsigned long phys_frames_free; // frames left in the physical allocator
+};
+
+#endif //ALLOC_STATS_H
@@ -0,0 +1,38 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef CACHE_STATS_H
+#define CACHE_STATS_H
+
+// Disk block cache counters, filled in by the GET_CACHE_STATS syscall. Hits and misses count extents read.
+struct cache_stats_t
+{
+    unsigned long extent_bytes; // the cache holds whole extents of this many bytes
+    unsigned long capacity_extents;
+    unsigned long used_extents;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long fills; // transfers from a device into the cache
+    unsigned long readahead_extents; // extents prefetched before anything asked for them
+    unsigned long readahead_hits; // prefetched extents which were then read
+};
+
+#endif //CACHE_STATS_H
@@ -197,6 +197,30 @@ void munmap(void* addr, size_t length)
     );
 }
 
+void* sbrk(intptr_t increment)
+{
+    void* result;
+    asm volatile(
+        "int $0x80" // Trigger software interrupt
+        : "=a"(result)
+        : "a"(SYSCALL_t::SBRK), "b"(increment)
+        : "memory"
+    );
+    return result;
+}
+
+int get_alloc_stats(alloc_stats_t* dest)
+{
+    int result;
+    asm volatile(
+        "int $0x80" // Trigger software interrupt
+        : "=a"(result)
+        : "a"(SYSCALL_t::GET_ALLOC_STATS), "b"(dest)
+        : "memory"
+    );
+    return result;
+}
+
 u64 get_current_clock()
 {
     int low, high;
@@ -230,6 +254,54 @@ void yield()
         : "memory"
     );
 }
+
+int set_priority(const int priority)
+{
+    int ret;
+    asm volatile(
+        "int $0x80" // Trigger software interrupt
+        : "=a"(ret)
+        : "a"(SYSCALL_t::SET_PRIORITY), "b"(priority)
+        : "memory"
+    );
+    return ret;
+}
+
+int get_sched_stats(sched_stats_t* dest)
+{
+    int result;
+    asm volatile(
+        "int $0x80" // Trigger software interrupt
+        : "=a"(result)
+        : "a"(SYSCALL_t::GET_SCHED_STATS), "b"(dest)
+        : "memory"
+    );
+    return result;
+}
+
+int get_sched_report(sched_report_t* dest)
+{
+    int result;
+    asm volatile(
+        "int $0x80" // Trigger software interrupt
+        : "=a"(result)
+        : "a"(SYSCALL_t::GET_SCHED_REPORT), "b"(dest)
+        : "memory"
+    );
+    return result;
+}
+
+int get_cache_stats(cache_stats_t* dest)
+{
+    int result;
+    asm volatile(
+        "int $0x80" // Trigger software interrupt
+        : "=a"(result)
+        : "a"(SYSCALL_t::GET_CACHE_STATS), "b"(dest)
+        : "memory"
+    );
+    return result;
+}
 }
 
 int close(const int fd)
@@ -51,11 +51,29 @@ enum SYSCALL_t
     MMAP,
     MUNMAP,
     EXECF,
-    YIELD
+    YIELD,
+    GET_ALLOC_STATS,
+    SBRK,
+    SET_PRIORITY,
+    GET_SCHED_STATS,
+    GET_SCHED_REPORT,
+    GET_CACHE_STATS
+};
+
+// Scheduling classes for set_priority. A ready process in a higher class always runs before lower ones.
+enum PRIORITY_CLASS_t
+{
+    PRIORITY_CLASS_LOW = 1,
+    PRIORITY_CLASS_NORMAL = 10,
+    PRIORITY_CLASS_HIGH = 100
 };
 
 typedef struct tm tm;
 typedef struct event_t event_t;
+typedef struct alloc_stats_t alloc_stats_t;
+typedef struct sched_stats_t sched_stats_t;
+typedef struct sched_report_t sched_report_t;
+typedef struct cache_stats_t cache_stats_t;
 
 // files
 int write(int fd, const char* buf, unsigned long count);
@@ -96,10 +114,23 @@ void* mmap(void* addr, size_t length, int prot, int flags, int fd, size_t offset
 
 void munmap(void* addr, size_t length);
 
+void* sbrk(intptr_t increment);
+
+int get_alloc_stats(alloc_stats_t* dest);
+
 // scheduling
 int execf(int fid);
 
 void yield();
+
+int set_priority(int priority);
+
+int get_sched_stats(sched_stats_t* dest);
+
+int get_sched_report(sched_report_t* dest);
+
+// storage
+int get_cache_stats(cache_stats_t* dest);
 #ifdef __cplusplus
 }
 #endif
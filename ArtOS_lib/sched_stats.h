@@ -0,0 +1,83 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef SCHED_STATS_H
+#define SCHED_STATS_H
+
+// Scheduler counters, filled in by the GET_SCHED_STATS syscall. Times are in TSC ticks.
+struct sched_stats_t
+{
+    unsigned long long total_ticks; // since the scheduler started
+    unsigned long long idle_ticks; // spent in the idle task, mostly halted
+    unsigned long long tsc_frequency; // TSC ticks per second, to convert the above
+    unsigned long timer_interrupts; // LAPIC one-shots which fired
+    unsigned long ticks_skipped; // time slices which passed in the idle task without a timer interrupt
+    unsigned long idle_entries; // switches to the idle task
+    unsigned long tickless_entries; // switches to the idle task with no timer armed at all
+    unsigned long io_wakeups; // device interrupts which switched out of the idle task to a process whose read finished
+    unsigned long fpu_traps; // device-not-available traps taken to hand the FPU to another process
+    unsigned long fpu_saves; // FXSAVEs those traps needed, the previous owner had to be saved
+};
+
+#define SCHED_REPORT_MAX_PROCESSES 32
+#define SCHED_REPORT_MAX_TRACE 64
+
+// CPU time split of one live process. Times are in TSC ticks.
+struct process_stats_t
+{
+    unsigned long pid;
+    char name[32];
+    char state; // R ready or running, S sleeping, P parked (waiting on I/O or a child), X exited
+    int priority;
+    unsigned long long run_ticks;
+    unsigned long long io_wait_ticks; // blocked on a read
+    unsigned long long sleep_ticks;
+    unsigned long preemptions; // switched out by the timer
+    unsigned long yields; // gave up the CPU through a syscall
+};
+
+enum SCHED_TRACE_t
+{
+    SCHED_TRACE_SWITCH, // pid is switched out, arg is the pid switched in
+    SCHED_TRACE_WAKE, // sleep deadline passed
+    SCHED_TRACE_SLEEP, // arg is the requested time in ms
+    SCHED_TRACE_IO_START, // arg is the file descriptor
+    SCHED_TRACE_IO_COMPLETE,
+};
+
+struct sched_trace_event_t
+{
+    unsigned long long tsc;
+    unsigned short type; // SCHED_TRACE_t
+    unsigned short pid;
+    unsigned long arg;
+};
+
+// Filled in by the GET_SCHED_REPORT syscall.
+struct sched_report_t
+{
+    unsigned long n_processes;
+    unsigned long n_trace; // newest events, oldest first
+    unsigned long trace_total; // events recorded since boot, including those no longer in the ring
+    process_stats_t processes[SCHED_REPORT_MAX_PROCESSES];
+    sched_trace_event_t trace[SCHED_REPORT_MAX_TRACE];
+};
+
+#endif //SCHED_STATS_H
@@ -43,6 +43,7 @@
 #include "PIT.h"
 #include "EventQueue.h"
 #include "IDEStorageContainer.h"
+#include "BlockCache.h"
 #include "ATA.h"
 #include "BusMasterController.h"
 #include "CPUID.h"
@@ -125,6 +126,9 @@ void kernel_main(unsigned long magic, unsigned long boot_info_addr)
     // And then we want graphics.
     VideoGraphicsArray vga(frame_info);
     vga.draw();
+#if BENCHMARK_BLIT
+    vga.benchmarkBlit(100);
+#endif
 
     // Then we disable the old PIC.
     PIC::disable_entirely();
@@ -185,6 +189,9 @@ void kernel_main(unsigned long magic, unsigned long boot_info_addr)
 
     CPUID_init(); // load CPUID values and try and get TSC rate otherwise get TSC rate from PIT calibration
     local_apic->configure_timer(DIVISOR_128); // use TSC rate to calibrate TSC->LAPIC timer ratio and calculate LAPIC timer rate at given divisor
+#if BENCHMARK_CONTEXT_SWITCH
+    paging_benchmark_address_space_switch(1000);
+#endif
 
     // TODO: In order to implement scheduling:
     // todo: Processes need a way to yield
@@ -275,6 +282,7 @@ void kernel_main(unsigned long magic, unsigned long boot_info_addr)
     char dev_name[] = "/dev/cdrom0";
     auto secondary_bus_master = BusMasterController(BM_controller_base_port, &drive_list[cd_idx]);
     vga.incrementProgressBarChunk(bar);
+    block_cache().init(BLOCK_CACHE_MIB * 1024 * 1024);
     auto CD_ROM = new IDEStorageContainer(drive_list[cd_idx], PCI_IDE_controller, &secondary_bus_master, dev_name);
     vga.incrementProgressBarChunk(bar);
     CD_ROM->mount();
@@ -89,9 +89,8 @@ public:
     }
 
     i64 seek([[maybe_unused]] u64 byte_offset, [[maybe_unused]] int whence) override { return 0; }
-    i64 async_read(char* dest, [[maybe_unused]] size_t byte_offset, size_t byte_count) override { return -1; }
+    int submit_read([[maybe_unused]] io_request_t* request) override { return -1; }
     bool device_busy() override { return false; }
-    virtual i64 async_n_read() { return -1; }
     char* get_name() override { return name; }
 
 
@@ -67,17 +67,14 @@ size_t ArtFile::read(char* dest, size_t byte_count)
     return rc;
 }
 
-int ArtFile::start_async_read(char* dest, size_t byte_count) const
+/* Fill in where request reads from and hand it to the device. Returns 0 once queued or -1 if it must be read
+ * synchronously instead. */
+int ArtFile::start_async_read(io_request_t* request) const
 {
-    // TODO: handle checks here.
-    // if (byte_count > 1024*64) {byte_count = 1024*64;}
-
-
-    if (seek_pos + byte_count > size) { byte_count = size - seek_pos; }
-    if (byte_count == 0) { return 0; }
-    // TODO: figure out what this should return.
+    if (seek_pos + request->n_bytes > size) { request->n_bytes = size - seek_pos; }
     // calculates position in disk from start position of file + seek pos
-    return device->async_read(dest, first_byte + seek_pos, byte_count);
+    request->byte_offset = first_byte + seek_pos;
+    return device->submit_read(request);
 }
 
 bool ArtFile::device_busy() const
@@ -127,7 +124,17 @@ const char* ArtFile::get_name()
     return filename;
 }
 
-i64 ArtFile::async_n_read()
+StorageDevice* ArtFile::get_device() const
+{
+    return device;
+}
+
+u64 ArtFile::get_first_byte() const
+{
+    return first_byte;
+}
+
+u64 ArtFile::get_size() const
 {
-    return device->async_n_read();
+    return size;
 }
@@ -26,6 +26,7 @@
 
 class ArtDirectory;
 class StorageDevice;
+struct io_request_t;
 
 struct FileData;
 
@@ -38,13 +39,14 @@ public:
 
 
     size_t read(char* dest, size_t byte_count);
-    int start_async_read(char* dest, size_t byte_count) const;
+    int start_async_read(io_request_t* request) const;
     bool device_busy() const;
     _PDCLIB_int_least64_t seek(u64 byte_offset, int whence);
     int write(const char* src, size_t byte_count);
     const char* get_name();
-
-    i64 async_n_read();
+    StorageDevice* get_device() const;
+    u64 get_first_byte() const;
+    u64 get_size() const;
 
 private:
     ArtDirectory* parent_directory;
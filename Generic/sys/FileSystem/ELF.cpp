@@ -84,49 +84,124 @@ err_program_read:
     art_string::memset(&elf_header, 0, sizeof(ELF_header_t));
 }
 
+ELF_image_t image_cache[ELF_image_cache_capacity];
+size_t image_cache_next = 0; // slot replaced by the next load once the cache is full
+
+ELF_image_t* ELF::find_cached_image()
+{
+    if (file->get_device() == nullptr) return nullptr;
+    for (auto& image : image_cache)
+    {
+        if (image.sections != nullptr && image.device == file->get_device() &&
+            image.first_byte == file->get_first_byte() && image.file_size == file->get_size())
+        {
+            return &image;
+        }
+    }
+    return nullptr;
+}
+
+/*
+ * Read every allocatable section with file contents into kernel memory and record it in the cache, replacing the
+ * oldest entry if it is full. Processes map these frames rather than owning copies.
+ */
+ELF_image_t* ELF::load_image()
+{
+    size_t n_sections = 0;
+    for (size_t i = 0; i < elf_header.e_shnum; i++)
+    {
+        const auto& header = section_header_table[i];
+        if (header.sh_addr > 0 && header.sh_flags & ELF_FLAG_ALLOCATE && header.sh_type != ELF_SECTION_NOBITS)
+        {
+            n_sections++;
+        }
+    }
+    auto* sections = static_cast<ELF_cached_section_t*>(art_alloc(sizeof(ELF_cached_section_t) * MAX(n_sections, 1), 0));
+    if (sections == nullptr) return nullptr;
+    ELF_image_t image = {file->get_device(), file->get_first_byte(), file->get_size(), 0, sections};
+
+    for (size_t i = 0; i < elf_header.e_shnum; i++)
+    {
+        const auto& header = section_header_table[i];
+        if (header.sh_addr == 0 || !(header.sh_flags & ELF_FLAG_ALLOCATE) || header.sh_type == ELF_SECTION_NOBITS)
+        {
+            continue;
+        }
+        size_t fid = 0;
+        auto* data = static_cast<u8*>(kmmap(0, header.sh_size, PAGING_WRITABLE, 0, fid, 0));
+        if (data == nullptr)
+        {
+            release_image(&image);
+            return nullptr;
+        }
+        sections[image.n_sections++] = {header.sh_addr, header.sh_size, (header.sh_flags & ELF_FLAG_WRITABLE) != 0, data};
+        if (file->seek(header.sh_offset, SEEK_SET) != header.sh_offset ||
+            file->read(reinterpret_cast<char*>(data), header.sh_size) <= 0)
+        {
+            release_image(&image);
+            return nullptr;
+        }
+    }
+
+    ELF_image_t* slot = &image_cache[image_cache_next];
+    image_cache_next = (image_cache_next + 1) % ELF_image_cache_capacity;
+    release_image(slot);
+    *slot = image;
+    return slot;
+}
+
+/* Drop the cache's hold on an image's frames. Frames still mapped by a process stay until it unmaps them. */
+void ELF::release_image(ELF_image_t* image)
+{
+    if (image->sections == nullptr) return;
+    for (size_t i = 0; i < image->n_sections; i++)
+    {
+        const auto& section = image->sections[i];
+        const size_t n_pages = (section.size + page_alignment - 1) / page_alignment;
+        for (size_t page = 0; page < n_pages; page++)
+        {
+            u8* page_addr = section.data + page * page_alignment;
+            const uintptr_t phys_addr = kget_mapping_target(page_addr);
+            kunmap_physical(page_addr, page_alignment);
+            page_frame_release(phys_addr);
+        }
+    }
+    art_free(image->sections);
+    *image = ELF_image_t{};
+}
+
 int ELF::execute()
 {
+    const ELF_image_t* image = find_cached_image();
+    if (image == nullptr) image = load_image();
+    if (image == nullptr) return -1;
+
     const auto user_table = new PagingTableUser();
     uintptr_t stack_vaddr = 0;
     uintptr_t stack_size = 0;
-    // loop through section headers
+    // Every process maps the cached frames. Writable sections are copied a page at a time on first write.
+    for (size_t i = 0; i < image->n_sections; i++)
+    {
+        const auto& section = image->sections[i];
+        const size_t n_pages = (section.size + page_alignment - 1) / page_alignment;
+        for (size_t page = 0; page < n_pages; page++)
+        {
+            user_table->assign_shared_page(kget_mapping_target(section.data + page * page_alignment),
+                                           section.v_addr + page * page_alignment,
+                                           section.writable);
+        }
+    }
     for (size_t i = 0; i < elf_header.e_shnum; i++)
     {
         const auto& header = section_header_table[i];
-        if (header.sh_addr > 0 && header.sh_flags & ELF_FLAG_ALLOCATE)
+        if (header.sh_addr > 0 && header.sh_flags & ELF_FLAG_ALLOCATE && header.sh_type == ELF_SECTION_NOBITS)
         {
-            size_t fid = 0;
-            void* section = kmmap(header.sh_addr, header.sh_size, header.sh_flags & ELF_FLAG_WRITABLE, PAGING_USER, fid, 0);
-            void* working_vaddr = section;
-            const size_t n_pages = (header.sh_size + page_alignment - 1) / page_alignment;
-            file->seek(header.sh_offset, SEEK_SET);
-            // this assumes that the physical pages are not guaranteed to be contiguous when assigned.
-            for (size_t page = 0; page < n_pages; page++)
-            {
-                uintptr_t phys_addr = kget_mapping_target(working_vaddr);
-                user_table->assign_page_table_entries(phys_addr,
-                                                      header.sh_addr + page * page_alignment,
-                                                      header.sh_flags & ELF_FLAG_WRITABLE,
-                                                      true);
-                if (header.sh_type != 8)
-                {
-                    // TODO: the working addr should take into account the offset!
-                    // TODO: this alignment fix needs testing!
-                    file->read(static_cast<char*>(working_vaddr + header.sh_addr % page_alignment), MIN(header.sh_size - (page * page_alignment), page_alignment));
-                }
-                else
-                {
-                    art_string::memset(working_vaddr, 0, MIN(header.sh_size - (page * page_alignment), page_alignment));
-                }
-                working_vaddr += page_alignment;
-            }
-            if (header.sh_type == 0x8)
-            {
-                stack_vaddr = header.sh_addr;
-                stack_size = header.sh_size;
-            }
-            //todo: doesn't seem to be unmapping whole region properly.
-            // HERE unmap would mark the physical memory as free but it is mapped in user space :o
+            // .bss and the stack have no file contents so they are backed on first touch instead of up front.
+            const uintptr_t first_page = header.sh_addr & ~(page_alignment - 1);
+            const size_t n_pages = (header.sh_addr + header.sh_size - first_page + page_alignment - 1) / page_alignment;
+            user_table->assign_demand_zero(first_page, n_pages, header.sh_flags & ELF_FLAG_WRITABLE);
+            stack_vaddr = header.sh_addr;
+            stack_size = header.sh_size;
         }
     }
     Scheduler::execute_from_paging_table(user_table, file->get_name(), elf_header.e_entry, stack_vaddr, stack_size);
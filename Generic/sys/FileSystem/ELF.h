@@ -87,6 +87,29 @@ constexpr u32 ELF_ISA_x86 = 0x3;
 constexpr u32 ELF_FLAG_WRITABLE = 0x1;
 constexpr u32 ELF_FLAG_ALLOCATE = 0x2;
 constexpr u32 ELF_FLAG_EXECUTABLE = 0x4;
+constexpr u32 ELF_SECTION_NOBITS = 0x8;
+
+// Number of executables kept resident so relaunching them maps their sections instead of reading them again.
+constexpr size_t ELF_image_cache_capacity = 8;
+
+// A loaded section of a cached executable. data is the kernel mapping of the frames every process maps.
+struct ELF_cached_section_t
+{
+    uintptr_t v_addr;
+    size_t size;
+    bool writable;
+    u8* data;
+};
+
+// An executable's loaded sections, keyed by where the file lives on its device.
+struct ELF_image_t
+{
+    StorageDevice* device;
+    u64 first_byte;
+    u64 file_size;
+    size_t n_sections;
+    ELF_cached_section_t* sections;
+};
 
 class ELF
 {
@@ -97,6 +120,10 @@ public:
 
 private:
     // void mmap();
+    ELF_image_t* find_cached_image();
+    ELF_image_t* load_image();
+    static void release_image(ELF_image_t* image);
+
     ArtFile* file;
     ELF_header_t elf_header;
     ELF_program_header_t* program_header_table;
@@ -168,7 +168,7 @@ int art_read(const int file_id, char* buf, const size_t count)
 }
 
 extern "C"
-int art_async_read(const int file_id, char* buf, const size_t count)
+int art_async_read(const int file_id, io_request_t* request)
 {
     ArtFile* h = get_file_handle(file_id);
     if (h == NULL)
@@ -176,29 +176,7 @@ int art_async_read(const int file_id, char* buf, const size_t count)
         // unknown FD
         return -1;
     }
-    return h->start_async_read(buf, count);
-}
-
-bool art_dev_busy(const int file_id)
-{
-    ArtFile* h = get_file_handle(file_id);
-    if (h == NULL)
-    {
-        // unknown FD
-        return false;
-    }
-    return h->device_busy();
-}
-
-i64 art_async_n_read(const int file_id)
-{
-    ArtFile* h = get_file_handle(file_id);
-    if (h == NULL)
-    {
-        // unknown FD
-        return false;
-    }
-    return h->async_n_read();
+    return h->start_async_read(request);
 }
 
 
@@ -129,11 +129,9 @@ int art_write(int fd, const char *buf, unsigned long count);
 
 int art_read(int fd, char *buf, size_t count);
 
-int art_async_read(int file_id, char *buf, size_t count);
+struct io_request_t;
 
-bool art_dev_busy(int file_id);
-
-i64 art_async_n_read(int file_id);
+int art_async_read(int file_id, struct io_request_t *request);
 
 int art_exec(int fid);
 
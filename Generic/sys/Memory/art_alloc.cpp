@@ -23,6 +23,8 @@
 #include <stdlib.h>
 
 #include "LinkedList.h"
+#include "TSC.h"
+#include "art_slab.h"
 #include "memory.h"
 #include "paging.h"
 
@@ -30,6 +32,8 @@
 namespace art_allocator
 {
     size_t MIN_CHUNK_SIZE = 64; // arbitrary
+    constexpr size_t chunk_granularity = 16; // chunk sizes are rounded up to this so that split chunks stay aligned
+    constexpr size_t chunk_none = static_cast<size_t>(-1);
     /**
      * nodes and data for a linked list where the nodes are stored in a free list
      */
@@ -37,179 +41,306 @@ namespace art_allocator
     {
         void* start; // address in bytes
         size_t size; // in bytes
-        size_t prev;
-        size_t next;
+        size_t prev; // chunk which ends where this one starts or chunk_none
+        size_t next; // chunk which starts where this one ends or chunk_none. Links the free list for unused entries.
+        size_t page_next; // next chunk which starts in the same page as this one or chunk_none
+        size_t bin_prev; // neighbours in the size bin while memory_free
+        size_t bin_next;
         bool memory_free : 1;
         bool array_free : 1;
     };
 
     chunk_t* chunks; // A "free list" of chunks
     size_t n_chunks = 0; // current size of the chunks free list
-    size_t next_free_array_entry = 0; // the smallest idx in the free list which is free to write to
-    size_t end_chunk_idx = 0; // the index of the chunk which is the "tail" of the linked list
-    size_t highest_used_chunk = 0; // the index of the chunk which has the highest index in the free list (should be equal to n_chunks but might not be?)
+    size_t free_entry_head = chunk_none; // first entry in the free list which is free to write to
 
+    alloc_stats_t alloc_stats = {};
+    constexpr size_t search_sample_mask = 63; // time one in every 64 chunk searches
 
-    /** Doubles the capacity of the chunks free list
+    /**
+     * Free chunks are kept in two level segregated size bins (TLSF). The first level is the power of two of the size
+     * and the second splits each power of two into bin_sl_count linear steps. Sizes below bin_small_size all live in
+     * first level 0 in steps of chunk_granularity. A bit is set in the bitmaps for every non-empty bin.
+     */
+    constexpr size_t bin_sl_log2 = 3;
+    constexpr size_t bin_sl_count = 1 << bin_sl_log2;
+    constexpr size_t bin_small_shift = 7;
+    constexpr size_t bin_small_size = 1 << bin_small_shift;
+    constexpr size_t bin_fl_count = 32 - bin_small_shift + 1;
+
+    u32 bin_fl_bitmap = 0;
+    u32 bin_sl_bitmap[bin_fl_count];
+    size_t bin_heads[bin_fl_count][bin_sl_count];
+
+
+    /** Doubles the capacity of the chunks free list, or creates it with a single page if it doesn't exist yet
      *
      * @return true for success and false for failure
      */
     bool expand_chunk_array()
     {
         size_t new_size = n_chunks * 2;
-        const size_t n_pages = (new_size * sizeof(chunk_t) + page_alignment - 1) / page_alignment;
+        size_t n_pages = (new_size * sizeof(chunk_t) + page_alignment - 1) / page_alignment;
+        if (n_pages == 0) n_pages = 1;
         new_size = n_pages * page_alignment / sizeof(chunk_t);
 
         auto* new_chunks = static_cast<chunk_t*>(kmmap(0, n_pages * page_alignment, PAGING_WRITABLE, 0, 0, 0));
 
         if (not new_chunks) return false;
 
-        art_string::memcpy(new_chunks, chunks, sizeof(chunk_t) * n_chunks);
-        // NOTE: always a full page so munmap is safe.
-        kmunmap(chunks, sizeof(chunk_t) * n_chunks);
-        for (size_t i = n_chunks; i < new_size; i++)
+        alloc_stats.pages_mapped += n_pages;
+        if (chunks)
         {
-            new_chunks[i].array_free = true;
+            art_string::memcpy(new_chunks, chunks, sizeof(chunk_t) * n_chunks);
+            // NOTE: always a full page so munmap is safe.
+            kmunmap(chunks, sizeof(chunk_t) * n_chunks);
+            alloc_stats.pages_unmapped += sizeof(chunk_t) * n_chunks / page_alignment;
+            ++alloc_stats.chunk_array_expansions;
+        }
+        for (size_t i = new_size; i-- > n_chunks;)
+        {
+            new_chunks[i] = chunk_t{nullptr, 0, chunk_none, free_entry_head, chunk_none, chunk_none, chunk_none, false, true};
+            free_entry_head = i;
         }
         chunks = new_chunks;
         n_chunks = new_size;
         return true;
     }
 
-    // This is for getting where to store the new chunk info after getting new pages, or when splitting a chunk to assign part of a chunk
-    /** Scans the free list to find a suitable place to store a new chunk. This will call function to expand the free list if full
+
+    /** Add a chunk to the address index. The index is the page map shared with the slab layer: each page holds the
+     * index (plus one) of a chunk which starts in it and further chunks starting in that page are linked via page_next.
      *
-     * @param start_idx the index at which to look above, saves time
-     * @return the
+     * @param idx the index of the chunk entry to index
      */
-    size_t get_next_free_array_entry(const size_t start_idx)
+    void index_chunk(const size_t idx)
     {
-        size_t idx = start_idx;
-        while (true)
+        const auto addr = reinterpret_cast<uintptr_t>(chunks[idx].start);
+        const u32 head = page_map_get(addr);
+        chunks[idx].page_next = head ? head - 1 : chunk_none;
+        // NOTE: if the page map can't grow the chunk is simply never found by art_free and is leaked.
+        page_map_set(addr, idx + 1);
+    }
+
+
+    /** Remove a chunk from the address index
+     *
+     * @param idx the index of the chunk entry to remove
+     */
+    void unindex_chunk(const size_t idx)
+    {
+        const auto addr = reinterpret_cast<uintptr_t>(chunks[idx].start);
+        const u32 head = page_map_get(addr);
+        if (!head) return;
+        if (head - 1 == idx)
         {
-            while (idx < n_chunks)
+            const size_t page_next = chunks[idx].page_next;
+            page_map_set(addr, page_next == chunk_none ? 0 : page_next + 1);
+            return;
+        }
+        for (size_t cur = head - 1; chunks[cur].page_next != chunk_none; cur = chunks[cur].page_next)
+        {
+            if (chunks[cur].page_next == idx)
             {
-                if (chunks[idx].array_free)
-                {
-                    next_free_array_entry = idx;
-                    return idx;
-                }
-
-                ++idx;
+                chunks[cur].page_next = chunks[idx].page_next;
+                return;
             }
-            expand_chunk_array(); // Expand the array and try again
-            return idx;
         }
     }
 
 
-    /** Scans the chunks array for the index of the highest used chunk
+    /** Look up the chunk which starts at exactly ptr
+     *
+     * @param ptr start address of the chunk
+     * @return index of the chunk or chunk_none if no chunk starts there
+     */
+    size_t find_chunk(const void* ptr)
+    {
+        const u32 head = page_map_get(reinterpret_cast<uintptr_t>(ptr));
+        if (!head || head & page_map_slab_flag) return chunk_none;
+        for (size_t cur = head - 1; cur != chunk_none; cur = chunks[cur].page_next)
+        {
+            if (chunks[cur].start == ptr) return cur;
+        }
+        return chunk_none;
+    }
+
+
+    /** Index of the most significant set bit
      *
-     * @return the index of the highest used chunk or 0 if none are free.
+     * @param value non-zero value
+     * @return bit index
      */
-    size_t get_highest_used_chunk()
+    size_t most_significant_bit(const size_t value)
     {
-        size_t idx = 0;
+        return sizeof(unsigned long) * 8 - 1 - __builtin_clzl(value);
+    }
+
 
-        while (idx < n_chunks)
+    /** Work out which bin a free chunk of this size is stored in
+     *
+     * @param size_bytes chunk size
+     * @param fl first level index output
+     * @param sl second level index output
+     */
+    void bin_mapping(const size_t size_bytes, size_t& fl, size_t& sl)
+    {
+        if (size_bytes < bin_small_size)
         {
-            if (chunks[idx].array_free)
-            {
-                if (idx == 0) return 0;
-                return idx - 1;
-            }
-            ++idx;
+            fl = 0;
+            sl = size_bytes / (bin_small_size / bin_sl_count);
+            return;
         }
-        return 0;
+        const size_t msb = most_significant_bit(size_bytes);
+        fl = msb - bin_small_shift + 1;
+        sl = size_bytes >> (msb - bin_sl_log2) ^ bin_sl_count;
     }
 
 
-    /** When the chunk is merged or otherwise removed from play, this will free an entry in the free list
-     * It also handles updating the tracker items such as next_free_array_entry
+    /** Put a free chunk into its size bin
      *
-     * @param idx the index of the chunk entry to be freed
+     * @param idx the index of a free chunk
      */
-    void remove_chunk_from_array(const size_t idx)
+    void bin_insert(const size_t idx)
+    {
+        size_t fl, sl;
+        bin_mapping(chunks[idx].size, fl, sl);
+        const size_t head = bin_heads[fl][sl];
+        chunks[idx].bin_prev = chunk_none;
+        chunks[idx].bin_next = head;
+        if (head != chunk_none) chunks[head].bin_prev = idx;
+        bin_heads[fl][sl] = idx;
+        bin_fl_bitmap |= 1u << fl;
+        bin_sl_bitmap[fl] |= 1u << sl;
+    }
+
+
+    /** Take a free chunk out of its size bin. Must be called before its size changes.
+     *
+     * @param idx the index of a free chunk
+     */
+    void bin_remove(const size_t idx)
+    {
+        size_t fl, sl;
+        bin_mapping(chunks[idx].size, fl, sl);
+        const size_t prev = chunks[idx].bin_prev;
+        const size_t next = chunks[idx].bin_next;
+        if (next != chunk_none) chunks[next].bin_prev = prev;
+        if (prev != chunk_none)
+        {
+            chunks[prev].bin_next = next;
+            return;
+        }
+        bin_heads[fl][sl] = next;
+        if (next != chunk_none) return;
+        bin_sl_bitmap[fl] &= ~(1u << sl);
+        if (!bin_sl_bitmap[fl]) bin_fl_bitmap &= ~(1u << fl);
+    }
+
+
+    /** Find a free chunk which is at least size_bytes big. The size is rounded up to the next bin boundary first so
+     * that any chunk in the first non-empty bin found is big enough.
+     *
+     * @param size_bytes required number of bytes
+     * @return index of a free chunk or chunk_none if no bin can satisfy the request
+     */
+    size_t bin_find(size_t size_bytes)
     {
-        if (idx < next_free_array_entry) next_free_array_entry = idx;
-        if (idx == end_chunk_idx & end_chunk_idx >= 1) end_chunk_idx = chunks[idx].prev;
-        chunks[idx] = chunk_t{nullptr, 0, 0, 0, false, true};
-        if (idx == highest_used_chunk & highest_used_chunk >= 1) highest_used_chunk = get_highest_used_chunk();
+        if (size_bytes >= bin_small_size)
+        {
+            size_bytes += (static_cast<size_t>(1) << (most_significant_bit(size_bytes) - bin_sl_log2)) - 1;
+        }
+        size_t fl, sl;
+        bin_mapping(size_bytes, fl, sl);
+        if (fl >= bin_fl_count) return chunk_none;
+
+        u32 sl_map = bin_sl_bitmap[fl] & (~0u << sl);
+        if (!sl_map)
+        {
+            const u32 fl_map = fl + 1 < bin_fl_count ? bin_fl_bitmap & (~0u << (fl + 1)) : 0;
+            if (!fl_map) return chunk_none;
+            fl = __builtin_ctz(fl_map);
+            sl_map = bin_sl_bitmap[fl];
+        }
+        return bin_heads[fl][__builtin_ctz(sl_map)];
     }
 
 
-    /** Creates a new chunk struct and stores it in the chunks free list
+    /** Takes an entry from the free list, expanding it if needed, and stores a new free chunk in it.
+     * The chunk is not linked to any neighbours.
      *
      * @param start the start address of the memory region handled by this chunk
      * @param size the size of the aforementioned memory region
-     * @return the index of the newly stored chunk
+     * @return the index of the newly stored chunk or chunk_none if the free list could not be expanded
      */
     size_t append_chunk(void* start, const size_t size)
     {
-        // TODO: update next of the prev chunk on append
-        // NORMAL BEHAVIOUR:
-
-        const size_t idx = get_next_free_array_entry(next_free_array_entry);
-        chunks[end_chunk_idx].next = idx; // end chunk idx should be "last assigned"
-        const size_t new_next = get_next_free_array_entry(idx);
-        const chunk_t chunk_data = {start, size, end_chunk_idx, new_next, true, false};
-        chunks[idx] = chunk_data;
-        next_free_array_entry = new_next;
-        // this assumes pages aren't given back so some checks about highest memory loc or something?
-        end_chunk_idx = idx;
-        highest_used_chunk = idx;
+        if (free_entry_head == chunk_none && !expand_chunk_array()) return chunk_none;
+        const size_t idx = free_entry_head;
+        free_entry_head = chunks[idx].next;
+        ++alloc_stats.chunks_in_use;
+        chunks[idx] = chunk_t{start, size, chunk_none, chunk_none, chunk_none, chunk_none, chunk_none, true, false};
+        index_chunk(idx);
+        bin_insert(idx);
         return idx;
     }
 
 
+    /** When the chunk is merged or otherwise removed from play, this will free an entry in the free list
+     *
+     * @param idx the index of the chunk entry to be freed
+     */
+    void remove_chunk_from_array(const size_t idx)
+    {
+        if (chunks[idx].memory_free) bin_remove(idx);
+        unindex_chunk(idx);
+        chunks[idx] = chunk_t{nullptr, 0, chunk_none, free_entry_head, chunk_none, chunk_none, chunk_none, false, true};
+        free_entry_head = idx;
+        --alloc_stats.chunks_in_use;
+    }
+
+
     /** Calls mmap to get new memory from the paging system to be used by the calling process.
+     * Each mapping is its own run of chunks so neighbours never cross into another mapping.
      *
      * @param size_bytes number of bytes to allocate
-     * @param alignment_size the alignment in bytes
-     * @return the index associated with the chunk which is now at least size_bytes big (can be merged)
+     * @return the index associated with the chunk which is now at least size_bytes big or chunk_none on failure
      */
-    size_t get_pages_for_new_chunk(const size_t size_bytes, const size_t alignment_size = 1)
+    size_t get_pages_for_new_chunk(const size_t size_bytes)
     {
         const size_t n_pages = (size_bytes + page_alignment - 1) / page_alignment;
         const size_t got_bytes = n_pages * page_alignment;
-        const auto ptr = kmmap(0, n_pages * page_alignment, PAGING_WRITABLE, 0, 0, 0);
-        if (!ptr)
-        {
-            exit(-1);
-        }
-        if (chunk_t* end_chunk = &chunks[end_chunk_idx];
-            end_chunk->start + end_chunk->size == ptr &&
-            end_chunk->memory_free &&
-            reinterpret_cast<uintptr_t>(end_chunk->start) % alignment_size == 0) // is it contiguous and suitable
+        const auto ptr = kmmap(0, got_bytes, PAGING_WRITABLE, 0, 0, 0);
+        if (!ptr) return chunk_none;
+
+        const size_t chunk_idx = append_chunk(ptr, got_bytes);
+        if (chunk_idx == chunk_none)
         {
-            end_chunk->size += got_bytes;
-            return end_chunk_idx;
+            kmunmap(ptr, got_bytes);
+            return chunk_none;
         }
-        // assumes always adding to end:
-        const size_t chunk_idx = append_chunk(ptr, got_bytes);
-
+        alloc_stats.pages_mapped += n_pages;
         return chunk_idx;
     }
 
 
-    /**
+    /** Splits a chunk in two. The latter part is always free and the prior keeps its state.
      *
      * @param prior index of the chunk to be split
      * @param size_bytes the amount of bytes to keep in the first chunk
-     * @return the index of latter chunk which is created
+     * @return the index of latter chunk which is created or chunk_none on failure
      */
     size_t split_chunk(const size_t prior, const size_t size_bytes)
     {
-        // TODO: should probably do some rounding or enforcement of minimum 4byte boundaries here.
-        void* const new_start = chunks[prior].start + size_bytes;
-        const size_t new_size = chunks[prior].size - size_bytes;
-        const auto latter = append_chunk(new_start, new_size);
-        chunks[latter].next = chunks[prior].next; // doesn't work if not set >.>
+        const auto latter = append_chunk(chunks[prior].start + size_bytes, chunks[prior].size - size_bytes);
+        if (latter == chunk_none) return chunk_none;
+        chunks[latter].next = chunks[prior].next;
+        if (chunks[latter].next != chunk_none) chunks[chunks[latter].next].prev = latter;
+        chunks[latter].prev = prior;
         chunks[prior].next = latter;
-        chunks[prior].memory_free = false;
+        if (chunks[prior].memory_free) bin_remove(prior);
         chunks[prior].size = size_bytes;
-        chunks[latter].prev = prior;
-        chunks[latter].memory_free = true;
+        if (chunks[prior].memory_free) bin_insert(prior);
         return latter;
     }
 
@@ -222,59 +353,92 @@ namespace art_allocator
     void merge_chunk(const size_t prior, const size_t latter)
     {
         chunks[prior].next = chunks[latter].next;
+        if (chunks[prior].next != chunk_none) chunks[chunks[prior].next].prev = prior;
+        if (chunks[prior].memory_free) bin_remove(prior);
         chunks[prior].size += chunks[latter].size;
+        if (chunks[prior].memory_free) bin_insert(prior);
         remove_chunk_from_array(latter);
     }
 
 
-    /** Get the next suitable chunk for memory which must be aligned
+    /** Gives any whole pages inside a free chunk back to the paging system. The parts of the chunk before and after
+     * those pages are kept as separate free chunks.
+     *
+     * @param idx the index of a free chunk
+     */
+    void release_whole_pages(const size_t idx)
+    {
+        const auto start = reinterpret_cast<uintptr_t>(chunks[idx].start);
+        const uintptr_t end = start + chunks[idx].size;
+        const uintptr_t first = (start + page_alignment - 1) & ~static_cast<uintptr_t>(page_alignment - 1);
+        const uintptr_t last = end & ~static_cast<uintptr_t>(page_alignment - 1);
+        if (first >= last) return;
+
+        const size_t next = chunks[idx].next;
+        if (end > last)
+        {
+            const size_t tail = append_chunk(reinterpret_cast<void*>(last), end - last);
+            if (tail == chunk_none) return; // keep the pages rather than lose track of the tail
+            chunks[tail].next = next;
+            if (next != chunk_none) chunks[next].prev = tail;
+        }
+        else if (next != chunk_none)
+        {
+            chunks[next].prev = chunk_none;
+        }
+
+        kmunmap(reinterpret_cast<void*>(first), last - first);
+        alloc_stats.pages_unmapped += (last - first) / page_alignment;
+
+        if (first > start)
+        {
+            bin_remove(idx);
+            chunks[idx].size = first - start;
+            chunks[idx].next = chunk_none;
+            bin_insert(idx);
+            return;
+        }
+        if (chunks[idx].prev != chunk_none) chunks[chunks[idx].prev].next = chunk_none;
+        remove_chunk_from_array(idx);
+    }
+
+
+    /** Get a free chunk for memory which must be aligned. Only bins whose chunks are big enough to hold the size
+     * plus the worst case padding in front of the aligned address are searched.
      *
      * @param size_bytes required number of bytes
      * @param alignment_size alignment in bytes e.g. 4 for 32bit integer
-     * @return index of first found/created suitable chunk
+     * @return index of found/created suitable chunk, the aligned address is inside it
      */
     size_t get_aligned_suitable_chunk(const size_t size_bytes, const size_t alignment_size)
     {
-        size_t idx = 0;
-        while (idx <= highest_used_chunk)
-        {
-            chunk_t* chunk = &chunks[idx];
-            ++idx;
-            if (!chunk->memory_free) continue;
-            if (chunk->size < size_bytes) continue;
-            if (reinterpret_cast<u32>(chunk->start) % alignment_size + size_bytes >= chunk->size) // if whole
-            {
-                if (reinterpret_cast<u32>(chunk->start) % alignment_size != 0)
-                {
-                }
-                return idx;
-            }
-        }
-        return get_pages_for_new_chunk(size_bytes, alignment_size);
+        // chunk starts are always chunk_granularity aligned
+        if (const size_t idx = bin_find(size_bytes + alignment_size - chunk_granularity); idx != chunk_none) return idx;
+        // pages are page aligned, so only bigger alignments need slack
+        return get_pages_for_new_chunk(size_bytes + (alignment_size > page_alignment ? alignment_size : 0));
     }
 
-    /** Get the next suitable chunk for memory which doesn't care about alignment
+    /** Get a free chunk for memory which doesn't care about alignment
      *
      * @param size_bytes required number of bytes
-     * @return index of first found/created suitable chunk
+     * @return index of found/created suitable chunk
      */
     size_t get_suitable_chunk(const size_t size_bytes)
     {
-        size_t idx = 0;
-        while (idx <= highest_used_chunk)
-        {
-            if (chunks[idx].memory_free & chunks[idx].size >= size_bytes)
-            {
-                return idx;
-            }
-            ++idx;
-        }
-        // TODO: this could calculate how many /more/ bytes to get instead of always getting enough for the whole object:
-        // i.e. if there are 5000 bytes required, this gets 2 pages but if there are > 4 bytes free at the end of the last
-        // chunk then this should only request one page and append the new page to old chunk. This is complicated to do
-        // without a refactor because the appending of a chunk also merges if possible atm.
+        if (const size_t idx = bin_find(size_bytes); idx != chunk_none) return idx;
         return get_pages_for_new_chunk(size_bytes);
     }
+
+
+    /** Count bytes handed out and track the high water mark
+     *
+     * @param size_bytes number of bytes handed out
+     */
+    void stats_add_live(const size_t size_bytes)
+    {
+        alloc_stats.bytes_live += size_bytes;
+        if (alloc_stats.bytes_live > alloc_stats.bytes_peak) alloc_stats.bytes_peak = alloc_stats.bytes_live;
+    }
 }
 
 
@@ -286,107 +450,137 @@ using namespace art_allocator;
 void art_memory_init()
 {
     LOG("Initialising memory allocator");
-    constexpr size_t n_pages = 1;
-    constexpr size_t new_size = page_alignment / sizeof(chunk_t);
-    auto* new_chunks = static_cast<chunk_t*>(kmmap(0, n_pages * page_alignment, PAGING_WRITABLE, 0, 0, 0));
+    for (auto& fl_heads : bin_heads)
+    {
+        for (auto& head : fl_heads) head = chunk_none;
+    }
 
-    if (not new_chunks)
+    if (not expand_chunk_array())
     {
         while (true)
         {
         }
     } // TODO: raise exception instead of hang.
-
-    chunks = new_chunks;
-    n_chunks = new_size;
-    chunks[0] = chunk_t{nullptr, 0, 0, 0, false, true};
-    for (size_t i = 0; i < n_chunks; ++i)
-    {
-        chunks[i].array_free = true;
-    }
 }
 
 
-/** Allocate memory for kernel use. Uses entire pages to store chunk information as a hybrid of a linked list with its nodes stored in a "free list" type of array.
+/** Allocate memory for kernel use. Requests which fit a slab size class (up to 2048 bytes including alignment) are
+ * popped from that class's free list. Larger requests use entire pages to store chunk information as a hybrid of a
+ * linked list with its nodes stored in a "free list" type of array.
  * When the chunk node array is full, that is reallocated by doubling its size. When chunks are allocated, chunks are split down to a minimum size of 64 bytes.
  *
  * @param size_bytes number of bytes to allocate
  * @param alignment_size level of alignment in bytes - defaults to 1 byte aligned (0 acts as 1)
  * @param flags optional flags
- * @return pointer to start of allocated memory in the chunk
+ * @return pointer to start of allocated memory in the chunk or nullptr if out of memory
  */
-void* art_alloc(const size_t size_bytes, size_t alignment_size, int flags)
+void* art_alloc(size_t size_bytes, size_t alignment_size, int flags)
 {
+    if (const size_t size_class = slab_class_for(size_bytes, alignment_size); size_class != slab_no_class)
+    {
+        return slab_alloc(size_class);
+    }
+
+    size_bytes = (size_bytes + chunk_granularity - 1) & ~(chunk_granularity - 1);
+    const bool sample = (alloc_stats.chunk_allocs & search_sample_mask) == 0;
+    const u64 search_start = sample ? TSC_get_ticks() : 0;
     size_t chunk_idx;
-    if (alignment_size == 0 or alignment_size == 1)
+    if (alignment_size <= chunk_granularity)
     {
         chunk_idx = get_suitable_chunk(size_bytes);
     }
     else
     {
         chunk_idx = get_aligned_suitable_chunk(size_bytes, alignment_size);
+        if (chunk_idx == chunk_none) return nullptr;
+        // leave the bytes before the aligned address behind as their own free chunk
+        if (const size_t misalignment = reinterpret_cast<uintptr_t>(chunks[chunk_idx].start) % alignment_size)
+        {
+            chunk_idx = split_chunk(chunk_idx, alignment_size - misalignment);
+        }
+    }
+    if (chunk_idx == chunk_none) return nullptr;
+    if (sample)
+    {
+        alloc_stats.search_ticks += TSC_get_ticks() - search_start;
+        ++alloc_stats.search_samples;
     }
+    bin_remove(chunk_idx);
     chunks[chunk_idx].memory_free = false;
 
-    // if excess space in chunk is too small to split, return it as is
-    if (chunks[chunk_idx].size - size_bytes <= MIN_CHUNK_SIZE)
+    // if data doesn't fill chunk enough we split it and reserve remaining unused memory, otherwise return it as is.
+    if (chunks[chunk_idx].size - size_bytes > MIN_CHUNK_SIZE)
     {
-        return chunks[chunk_idx].start;
+        split_chunk(chunk_idx, size_bytes);
     }
 
-    // otherwise data doesn't fill chunk enough so we split it and reserve remaining unused memory.
-    split_chunk(chunk_idx, size_bytes);
-
+    ++alloc_stats.chunk_allocs;
+    stats_add_live(chunks[chunk_idx].size);
     return chunks[chunk_idx].start;
 }
 
 
 /** Frees up previously allocated chunks when ptr is a valid start value of a chunk.
- * Upon freeing, previous and next chunks are checked to see if they can be merge with the newly freed chunk
+ * Slab objects are pushed back onto their size class free list. Chunks are found through the page map so this does
+ * not depend on how many chunks exist.
+ * Upon freeing, previous and next chunks are checked to see if they can be merge with the newly freed chunk and any
+ * whole pages which are left free are returned to the paging system.
  *
  * @param ptr address of the chunk allocated using art_alloc.
  */
 void art_free(const void* ptr)
 {
-    size_t idx = 0;
-    while (idx < n_chunks)
+    if (slab_free(ptr)) return;
+
+    size_t idx = find_chunk(ptr);
+    if (idx == chunk_none || chunks[idx].memory_free) return;
+    ++alloc_stats.chunk_frees;
+    alloc_stats.bytes_live -= chunks[idx].size;
+    chunks[idx].memory_free = true;
+    bin_insert(idx);
+
+    // neighbours are always contiguous in memory so only their state needs checking
+    if (const size_t next = chunks[idx].next; next != chunk_none && chunks[next].memory_free)
     {
-        if (chunks[idx].start == ptr)
-        {
-            // chunk_t* chunk = &chunks[idx];
-            chunks[idx].memory_free = true;
-            // IF prev is free and is contiguous
-            chunk_t this_chunk = chunks[idx];
-            chunk_t prev_chunk = chunks[chunks[idx].prev];
-            if (idx != 0 && prev_chunk.memory_free == true && prev_chunk.start + prev_chunk.size == this_chunk.start)
-            {
-                idx = chunks[idx].prev; // swap to prev because current will be deleted
-                merge_chunk(idx, chunks[idx].next);
-            }
-            // IF next is free and is contiguous
+        merge_chunk(idx, next);
+    }
+    if (const size_t prev = chunks[idx].prev; prev != chunk_none && chunks[prev].memory_free)
+    {
+        merge_chunk(prev, idx);
+        idx = prev;
+    }
 
-            chunk_t next_chunk = chunks[chunks[idx].next];
-            if (next_chunk.memory_free && this_chunk.start + this_chunk.size == next_chunk.start)
-            {
-                merge_chunk(idx, chunks[idx].next);
-            }
-            // if there are not free whole pages, we are done.
-            if (
-                chunks[idx].size < page_alignment or
-                not(
-                    reinterpret_cast<uintptr_t>(chunks[idx].start) % page_alignment == 0 and
-                    chunks[idx].size % 4096 == 0
-                )
-            )
-            {
-                return;
-            }
+    release_whole_pages(idx);
+}
 
-            // otherwise unmap those whole pages
-            kmunmap(chunks[idx].start, chunks[idx].size);
-            remove_chunk_from_array(idx);
-            return;
-        }
-        ++idx;
+
+/** Copy the allocator counters out, e.g. into a user buffer for the GET_ALLOC_STATS syscall
+ *
+ * @param dest where to write the counters
+ */
+void art_alloc_get_stats(alloc_stats_t* dest)
+{
+    alloc_stats.chunk_array_capacity = n_chunks;
+    art_string::memcpy(dest, &alloc_stats, sizeof(alloc_stats_t));
+}
+
+
+/** Print the allocator counters over the LOG path so runs can be compared
+ */
+void art_alloc_log_stats()
+{
+    alloc_stats.chunk_array_capacity = n_chunks;
+    LOG("Allocator stats:");
+    for (size_t i = 0; i < n_slab_classes; ++i)
+    {
+        LOG("slab ", static_cast<size_t>(1) << (i + slab_min_shift), " bytes: allocs: ", alloc_stats.slab_allocs[i],
+            " frees: ", alloc_stats.slab_frees[i]);
     }
+    LOG("slab pages: ", alloc_stats.slab_pages);
+    LOG("chunk allocs: ", alloc_stats.chunk_allocs, " frees: ", alloc_stats.chunk_frees);
+    LOG("bytes live: ", alloc_stats.bytes_live, " peak: ", alloc_stats.bytes_peak);
+    LOG("chunk array: ", alloc_stats.chunks_in_use, "/", alloc_stats.chunk_array_capacity, " expansions: ",
+        alloc_stats.chunk_array_expansions);
+    LOG("pages mapped: ", alloc_stats.pages_mapped, " unmapped: ", alloc_stats.pages_unmapped);
+    LOG("search ticks: ", alloc_stats.search_ticks, " over ", alloc_stats.search_samples, " samples");
 }
@@ -0,0 +1,159 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#include "art_slab.h"
+
+#include "paging.h"
+
+
+namespace art_allocator
+{
+    constexpr size_t page_map_dir_shift = 22;
+    constexpr size_t page_map_dir_len = 1024;
+    constexpr size_t page_map_leaf_len = page_alignment / sizeof(u32);
+
+    /**
+     * Two level radix tree indexed by page number. The top level is always present and each leaf covers 4 MiB of
+     * address space in a single page, which is only fetched from kmmap the first time something in that range is set.
+     */
+    u32* page_map_dirs[page_map_dir_len];
+
+    struct slab_object_t
+    {
+        slab_object_t* next;
+    };
+
+    slab_object_t* slab_free_lists[n_slab_classes]; // singly linked through the free objects themselves
+
+
+    /** Look up the page map entry for the page containing addr
+     *
+     * @param addr any address within the page
+     * @return the stored value or 0 if nothing was stored
+     */
+    u32 page_map_get(const uintptr_t addr)
+    {
+        const u32* leaf = page_map_dirs[(addr >> page_map_dir_shift) % page_map_dir_len];
+        if (!leaf) return 0;
+        return leaf[(addr >> base_address_shift) % page_map_leaf_len];
+    }
+
+
+    /** Store a value against the page containing addr, creating the leaf if needed
+     *
+     * @param addr any address within the page
+     * @param value value to store, 0 clears the entry
+     * @return false if a leaf was needed and could not be mapped
+     */
+    bool page_map_set(const uintptr_t addr, const u32 value)
+    {
+        u32*& leaf = page_map_dirs[(addr >> page_map_dir_shift) % page_map_dir_len];
+        if (!leaf)
+        {
+            if (value == 0) return true;
+            leaf = static_cast<u32*>(kmmap(0, page_alignment, PAGING_WRITABLE, 0, 0, 0));
+            if (!leaf) return false;
+            ++alloc_stats.pages_mapped;
+        }
+        leaf[(addr >> base_address_shift) % page_map_leaf_len] = value;
+        return true;
+    }
+
+
+    /** Pick the slab size class for an allocation. Objects are aligned to their own size within a page so the class
+     * also has to cover the requested alignment.
+     *
+     * @param size_bytes requested size
+     * @param alignment_size requested alignment in bytes
+     * @return the size class index or slab_no_class if the chunk allocator should handle it
+     */
+    size_t slab_class_for(size_t size_bytes, const size_t alignment_size)
+    {
+        if (alignment_size > size_bytes) size_bytes = alignment_size;
+        if (size_bytes > static_cast<size_t>(1) << slab_max_shift) return slab_no_class;
+        size_t shift = slab_min_shift;
+        while (static_cast<size_t>(1) << shift < size_bytes) ++shift;
+        return shift - slab_min_shift;
+    }
+
+
+    /** Get a new page from kmmap and carve it into free objects of the given class
+     *
+     * @param size_class index of the size class to refill
+     * @return false if no page was available
+     */
+    bool slab_refill(const size_t size_class)
+    {
+        const size_t object_size = static_cast<size_t>(1) << (size_class + slab_min_shift);
+        auto* page = static_cast<u8*>(kmmap(0, page_alignment, PAGING_WRITABLE, 0, 0, 0));
+        if (!page) return false;
+        if (!page_map_set(reinterpret_cast<uintptr_t>(page), page_map_slab_flag | size_class))
+        {
+            kmunmap(page, page_alignment);
+            return false;
+        }
+        ++alloc_stats.slab_pages;
+        ++alloc_stats.pages_mapped;
+        // push in reverse so that objects are handed out in ascending address order
+        for (size_t offset = page_alignment; offset >= object_size; offset -= object_size)
+        {
+            auto* object = reinterpret_cast<slab_object_t*>(page + offset - object_size);
+            object->next = slab_free_lists[size_class];
+            slab_free_lists[size_class] = object;
+        }
+        return true;
+    }
+
+
+    /** Pop an object off the free list for a size class. Slab pages are kept once fetched so that repeated
+     * allocate/free cycles never go back to the paging code.
+     *
+     * @param size_class index from slab_class_for
+     * @return pointer to the object or nullptr if out of memory
+     */
+    void* slab_alloc(const size_t size_class)
+    {
+        if (!slab_free_lists[size_class] && !slab_refill(size_class)) return nullptr;
+        slab_object_t* object = slab_free_lists[size_class];
+        slab_free_lists[size_class] = object->next;
+        ++alloc_stats.slab_allocs[size_class];
+        stats_add_live(static_cast<size_t>(1) << (size_class + slab_min_shift));
+        return object;
+    }
+
+
+    /** Return an object to its size class if it lives in a slab page
+     *
+     * @param ptr pointer previously returned by slab_alloc
+     * @return true if the pointer belonged to a slab and has been freed
+     */
+    bool slab_free(const void* ptr)
+    {
+        const u32 entry = page_map_get(reinterpret_cast<uintptr_t>(ptr));
+        if (!(entry & page_map_slab_flag)) return false;
+        const size_t size_class = entry & ~page_map_slab_flag;
+        auto* object = static_cast<slab_object_t*>(const_cast<void*>(ptr));
+        object->next = slab_free_lists[size_class];
+        slab_free_lists[size_class] = object;
+        ++alloc_stats.slab_frees[size_class];
+        alloc_stats.bytes_live -= static_cast<size_t>(1) << (size_class + slab_min_shift);
+        return true;
+    }
+}
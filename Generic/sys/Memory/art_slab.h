@@ -0,0 +1,54 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef ART_SLAB_H
+#define ART_SLAB_H
+
+#include "types.h"
+#include "alloc_stats.h"
+
+// Small object layer which sits in front of the chunk allocator. Each size class is a power of two between
+// 2^slab_min_shift and 2^slab_max_shift bytes and owns whole pages from kmmap which are carved into equal objects.
+namespace art_allocator
+{
+    constexpr size_t slab_min_shift = 4; // 16 bytes
+    constexpr size_t slab_max_shift = 11; // 2048 bytes
+    constexpr size_t n_slab_classes = slab_max_shift - slab_min_shift + 1;
+    constexpr size_t slab_no_class = n_slab_classes;
+
+    // Entries in the page map. Zero means the page is not owned by the allocator.
+    constexpr u32 page_map_slab_flag = 0x80000000;
+
+    static_assert(n_slab_classes == ALLOC_STATS_N_SLAB_CLASSES);
+
+    // Counters shared by the slab and chunk allocators
+    extern alloc_stats_t alloc_stats;
+
+    void stats_add_live(size_t size_bytes);
+
+    u32 page_map_get(uintptr_t addr);
+    bool page_map_set(uintptr_t addr, u32 value);
+
+    size_t slab_class_for(size_t size_bytes, size_t alignment_size);
+    void* slab_alloc(size_t size_class);
+    bool slab_free(const void* ptr);
+}
+
+#endif //ART_SLAB_H
@@ -37,6 +37,14 @@ void* art_alloc(size_t size_bytes, size_t alignment_size = 0, int flags = 0);
 // Free call used by kernel processes.
 void art_free(const void* ptr);
 
+struct alloc_stats_t;
+
+// Copy the allocator counters into dest.
+void art_alloc_get_stats(alloc_stats_t* dest);
+
+// Print the allocator counters over the LOG path.
+void art_alloc_log_stats();
+
 
 #endif
 
@@ -30,69 +30,69 @@ IO_read::IO_read(int* r, const int fd, char* dest, const size_t count)
 {
     _fd = fd;
     _buf = dest;
-    const size_t offset_in_page = (reinterpret_cast<uintptr_t>(dest) % page_alignment);
-    _k_buf = reinterpret_cast<char*>(kernel_pages().map_user_to_kernel(
-        reinterpret_cast<uintptr_t>(_buf),
-        count + offset_in_page) + offset_in_page);
     _count = count;
-    _state = NOT_STARTED;
+    _state = READY;
     result = r;
+    // Pins the user frames so the device can write straight into them for as long as the read is outstanding
+    const size_t offset_in_page = (reinterpret_cast<uintptr_t>(dest) % page_alignment);
+    const uintptr_t k_page = kernel_pages().map_user_to_kernel(reinterpret_cast<uintptr_t>(_buf),
+                                                               count + offset_in_page);
+    if (k_page == 0)
+    {
+        _k_buf = nullptr;
+        *result = -1;
+        _state = DONE;
+        return;
+    }
+    _k_buf = reinterpret_cast<char*>(k_page + offset_in_page);
+}
+
+/* Drop the kernel alias and the pins on the user frames. Called once on whichever path completes the read. */
+void IO_read::release_buffer()
+{
+    const size_t offset_in_page = (reinterpret_cast<uintptr_t>(_k_buf) % page_alignment);
+    kernel_pages().unmap_user_to_kernel(reinterpret_cast<uintptr_t>(_k_buf) - offset_in_page,
+                                        _count + offset_in_page);
+    _k_buf = nullptr;
 }
 
 IO_operation::IO_State IO_read::state()
 {
-    if (_state == NOT_STARTED && !art_dev_busy(_fd))
-    {
-        _state = READY;
-    }
-    if (_state == IN_PROGRESS)
-    {
-        if (const i64 n_read = art_async_n_read(_fd); n_read == _count)
-        {
-            const size_t offset_in_page = (reinterpret_cast<uintptr_t>(_k_buf) % page_alignment);
-            kernel_pages().unmap_user_to_kernel(reinterpret_cast<uintptr_t>(_k_buf),
-                                                _count + offset_in_page);
-            art_seek(_fd, n_read, SEEK_CUR);
-            *result = static_cast<int>(n_read);
-            _state = DONE;
-        }
-    }
     return _state;
 }
 
 void IO_read::do_op()
 {
 #if ASYNC_READ
-    switch (const int res = art_async_read(_fd, _k_buf,
-                                           _count))
+    request = io_request_t{_k_buf, 0, _count};
+    request.on_complete = &IO_read::complete;
+    request.context = this;
+    // The device may complete the request before returning, e.g. if it is cached
+    _state = IN_PROGRESS;
+    if (art_async_read(_fd, &request) == 0)
     {
-    case -1:
 #if ENABLE_SERIAL_LOGGING and LOG_SYSCALL
-        get_serial().log("Async not enabled, using synchronous read");
+        get_serial().log("async read queued");
 #endif
-        *result = art_read(_fd, _k_buf, _count);
-        _state = DONE;
-        break;
-    case 0:
-#if ENABLE_SERIAL_LOGGING and LOG_SYSCALL
-        get_serial().log("async read started");
-#endif
-        _state = IN_PROGRESS;
-        break;
-    default:
-#if ENABLE_SERIAL_LOGGING and LOG_SYSCALL
-        get_serial().log(res, " bytes of data already in buffer, returning directly");
-#endif
-        *result = res;
-        // If immediate, must seek else the seek happens on complete read.
-        art_seek(_fd, res, SEEK_CUR);
-        _state = DONE;
-        break;
+        return;
     }
-#else
+#endif
 #if ENABLE_SERIAL_LOGGING and LOG_SYSCALL
     get_serial().log("Async not enabled, using synchronous read");
 #endif
-    *ret = art_read(_fd, _k_buf, _count);
-#endif
+    *result = art_read(_fd, _k_buf, _count);
+    release_buffer();
+    _state = DONE;
+}
+
+/* Called by the device once the queued request has finished, usually from its interrupt handler. */
+void IO_read::complete(io_request_t* request)
+{
+    auto* op = static_cast<IO_read*>(request->context);
+    op->release_buffer();
+    // The seek happens here so that it only counts data which has arrived
+    if (request->result > 0) art_seek(op->_fd, request->result, SEEK_CUR);
+    *op->result = static_cast<int>(request->result);
+    op->_state = DONE;
+    if (op->on_done != nullptr) op->on_done(op); // last, because it may delete op
 }
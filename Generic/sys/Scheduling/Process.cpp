@@ -37,6 +37,11 @@ Process::Process() {
     user = false;
     cr3_val = 0;
     paging_table = nullptr;
+    next_queued = nullptr;
+    prev_queued = nullptr;
+    queued = false;
+    fpu_used = false;
+    reset_accounting();
 }
 
 void Process::reset() {
@@ -53,6 +58,12 @@ void Process::reset() {
     }
     user = false;
     cr3_val = 0;
+    paging_table = nullptr; // deleted by the scheduler once the process has exited
+    next_queued = nullptr;
+    prev_queued = nullptr;
+    queued = false;
+    fpu_used = false;
+    reset_accounting();
 }
 
 
@@ -69,6 +80,18 @@ void Process::start(const size_t parent_id, const cpu_registers_t &new_context,
     eventQueue = new EventQueue();
     art_string::strncpy(name, new_name, MIN(32, art_string::strlen(new_name)));
     user = is_user;
+    fpu_used = false;
+    reset_accounting();
+}
+
+void Process::reset_accounting() {
+    run_started = 0;
+    wait_started = 0;
+    run_ticks = 0;
+    io_wait_ticks = 0;
+    sleep_ticks = 0;
+    preemptions = 0;
+    yields = 0;
 }
 
 Process::~Process() {
@@ -35,6 +35,7 @@ struct Process
     Process();
     void reset();
     void start(size_t parent_id, const cpu_registers_t& new_context, void* new_stack, const char* new_name, bool is_user);
+    void reset_accounting();
     ~Process();
 
     enum State_t
@@ -58,6 +59,12 @@ struct Process
     bool isParked() { return state == STATE_PARKED; }
     bool isDead() { return state == STATE_DEAD; }
 
+    // Ready queue index, 0 runs first.
+    size_t priority_class() const
+    {
+        return priority == PRIORITY_HIGH ? 0 : priority == PRIORITY_NORMAL ? 1 : 2;
+    }
+
     u32 parent_pid;
     State_t state;
     Priority_t priority;
@@ -70,8 +77,25 @@ struct Process
     PagingTableUser* paging_table;
     uintptr_t cr3_val;
     u64 last_executed;
+    // Links in the scheduler's ready queue for this priority, or its exited list.
+    Process* next_queued;
+    Process* prev_queued;
+    bool queued;
+    // x87/SSE registers, saved lazily only once another process touches the FPU. Unused until fpu_used is set.
+    fpu_state_t fpu_state;
+    bool fpu_used;
+    // CPU accounting in TSC ticks, see process_stats_t.
+    u64 run_started;
+    u64 wait_started;
+    u64 run_ticks;
+    u64 io_wait_ticks;
+    u64 sleep_ticks;
+    u32 preemptions;
+    u32 yields;
 };
 
+constexpr size_t n_priority_classes = 3;
+
 
 #endif
 
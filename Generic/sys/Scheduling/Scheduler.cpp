@@ -38,7 +38,9 @@
 
 #include "CPUID.h"
 #include "memory.h"
-#include "LinkedList.h"
+#include "MinHeap.h"
+#include "TraceRing.h"
+#include "sched_stats.h"
 #include "EventQueue.h"
 #include "Process.h"
 #include "io_queue_entry.h"
@@ -52,12 +54,20 @@
 
 size_t context_switch_period_us = CONTEXT_SWITCH_PERIOD_US;
 
+// Absolute wake up time of a sleeping process in TSC ticks. Ordered by deadline in sleep_timers.
 struct sleep_timer_t
 {
+    u64 deadline;
     size_t pid;
-    long double counter;
+
+    bool operator<(const sleep_timer_t& other) const { return deadline < other.deadline; }
 };
 
+// Shortest one-shot the scheduler asks the LAPIC for, so a deadline which has nearly passed still gets a timer.
+constexpr u32 min_oneshot_us = 10;
+// Longest one-shot armed while idle. Keeps the LAPIC count in range for far away deadlines.
+constexpr u32 max_idle_oneshot_us = 1000000;
+
 
 size_t stack_alignment = 16;
 
@@ -70,8 +80,95 @@ size_t highest_assigned_pid = 0;
 Process processes[max_processes];
 LocalAPIC* lapic_timer = nullptr;
 
-LinkedList<sleep_timer_t> sleep_timers = {};
-LinkedList<io_queue_entry_t> IO_Queue = {};
+sched_stats_t sched_stats = {};
+u64 scheduler_start_ticks = 0;
+u64 idle_entered_ticks = 0;
+
+// Process whose registers are currently in the FPU, or max_processes if none. Everyone else runs with CR0.TS set.
+size_t fpu_owner = max_processes;
+bool lazy_fpu = false; // needs FXSAVE, otherwise the FPU is shared unsaved as before
+
+// Recent scheduler events for GET_SCHED_REPORT. Only written from the scheduler, which runs with interrupts disabled.
+TraceRing<sched_trace_event_t, 256> sched_trace;
+bool preempting = false; // schedule was entered from the timer rather than a syscall
+
+MinHeap<sleep_timer_t, max_processes> sleep_timers; // each process sleeps on at most one timer
+// Read being started by append_read. Its completion is handled there if the device finishes it before returning.
+IO_operation* submitting_io = nullptr;
+bool io_woken = false; // a device interrupt made a process ready, see wake_from_interrupt
+
+// kernel_main only starts the shell and is never scheduled again, as it has nothing left to run. A child exiting marks
+// it ready but does not queue it.
+constexpr size_t kernel_process_id = 0;
+// The idle task runs whenever every ready queue is empty so it is never queued itself.
+constexpr size_t idle_process_id = 1;
+// One FIFO of ready processes per priority class, linked through the processes. The running process is not queued.
+Process* ready_heads[n_priority_classes] = {};
+Process* ready_tails[n_priority_classes] = {};
+// Processes which have exited but whose resources have not been released yet.
+Process* exited_head = nullptr;
+
+void trace(const SCHED_TRACE_t type, const size_t pid, const u32 arg)
+{
+    sched_trace.push(sched_trace_event_t{
+        TSC_get_ticks(), static_cast<unsigned short>(type), static_cast<unsigned short>(pid), arg
+    });
+}
+
+void enqueue_ready(Process* proc)
+{
+    const size_t priority_class = proc->priority_class();
+    proc->next_queued = nullptr;
+    proc->prev_queued = ready_tails[priority_class];
+    if (ready_tails[priority_class] != nullptr) ready_tails[priority_class]->next_queued = proc;
+    else ready_heads[priority_class] = proc;
+    ready_tails[priority_class] = proc;
+    proc->queued = true;
+}
+
+void dequeue_ready(Process* proc)
+{
+    if (!proc->queued) return;
+    const size_t priority_class = proc->priority_class();
+    if (proc->prev_queued != nullptr) proc->prev_queued->next_queued = proc->next_queued;
+    else ready_heads[priority_class] = proc->next_queued;
+    if (proc->next_queued != nullptr) proc->next_queued->prev_queued = proc->prev_queued;
+    else ready_tails[priority_class] = proc->prev_queued;
+    proc->next_queued = nullptr;
+    proc->prev_queued = nullptr;
+    proc->queued = false;
+}
+
+/* Mark a process ready to run and queue it unless it is the one currently running or is never scheduled. */
+void make_ready(const size_t pid)
+{
+    Process* proc = &processes[pid];
+    proc->state = Process::STATE_READY;
+    if (!proc->queued && pid != current_process_id && pid != idle_process_id && pid != kernel_process_id)
+    {
+        enqueue_ready(proc);
+    }
+}
+
+/* Take a process off the ready queue because it is sleeping or waiting for something. */
+void make_waiting(const size_t pid, const Process::State_t state)
+{
+    dequeue_ready(&processes[pid]);
+    processes[pid].state = state;
+    processes[pid].wait_started = TSC_get_ticks();
+}
+
+void make_exited(const size_t pid)
+{
+    Process* proc = &processes[pid];
+    if (proc->state == Process::STATE_EXITED || proc->isDead()) return;
+    dequeue_ready(proc);
+    sleep_timers.remove_if([pid](const sleep_timer_t& t) { return t.pid == pid; });
+    if (fpu_owner == pid) fpu_owner = max_processes; // nothing worth saving
+    proc->state = Process::STATE_EXITED;
+    proc->next_queued = exited_head;
+    exited_head = proc;
+}
 
 extern u8 kernel_stack_top;
 extern u8 kernel_stack_bottom;
@@ -80,6 +177,9 @@ void idle_task()
 {
     while (true)
     {
+        // Spare cycles keep a stock of cleared frames so mmap does not have to zero them itself. Once the pool is full
+        // there is nothing left to do so halt until the next interrupt, which is only the timer if something is due.
+        if (!page_zero_pool_fill_one()) asm volatile("sti\n\thlt");
     };
 }
 
@@ -100,6 +200,10 @@ Scheduler::Scheduler(LocalAPIC* timer, EventQueue* kernel_queue)
     processes[0].eventQueue = kernel_queue;
     processes[0].stack = &kernel_stack_top;
     execution_counter = TSC_get_ticks();
+    processes[0].run_started = execution_counter;
+    scheduler_start_ticks = execution_counter;
+    sched_stats.tsc_frequency = cpuid_get_TSC_frequency();
+    lazy_fpu = cpuid_get_feature_info()->edx & 0x1 << 24; // FXSR
     create_idle_task();
 }
 
@@ -117,19 +221,40 @@ Scheduler::~Scheduler()
 void Scheduler::schedule(cpu_registers_t* const r)
 {
     store_current_context(r, current_process_id);
+    io_woken = false; // whoever was woken is queued and is considered below
     handle_exited_threads();
     handle_expired_timers();
-    handle_io();
+    if (current_process_id == idle_process_id) leave_idle();
     processes[current_process_id].last_executed = execution_counter;
+    processes[current_process_id].run_ticks += execution_counter - processes[current_process_id].run_started;
+    if (preempting) ++processes[current_process_id].preemptions;
+    else ++processes[current_process_id].yields;
+    // The process being switched away from goes to the back of its queue if it can still run.
+    if (Process* current = &processes[current_process_id];
+        current_process_id != idle_process_id && current_process_id != kernel_process_id &&
+        current->state == Process::STATE_READY && !current->queued)
+    {
+        enqueue_ready(current);
+    }
     size_t next_id = get_next_process_id();
+    if (next_id != idle_process_id) dequeue_ready(&processes[next_id]);
 #if ENABLE_SERIAL_LOGGING and LOG_IDLE
-    if (next_id == 1) {
+    if (next_id == idle_process_id) {
         get_serial().log("switching to idle task");
     }
 #endif
+    if (next_id != current_process_id) trace(SCHED_TRACE_SWITCH, current_process_id, next_id);
     current_process_id = next_id;
-    const auto priority = processes[current_process_id].priority;
-    start_oneshot(context_switch_period_us * priority);
+    processes[current_process_id].run_started = execution_counter;
+    if (next_id == idle_process_id)
+    {
+        enter_idle();
+    }
+    else
+    {
+        const auto priority = processes[current_process_id].priority;
+        start_oneshot(next_oneshot_us(context_switch_period_us * priority));
+    }
     set_current_context(r, current_process_id);
 }
 
@@ -157,122 +282,248 @@ size_t Scheduler::getMaxAliveProcessID()
 
 void Scheduler::handle_expired_timers()
 {
-    if (!sleep_timers.head_data())
-    {
-        execution_counter = TSC_get_ticks();
-        return;
-    }
     const u64 ticks = TSC_get_ticks();
-    long double elapsed_ms = (ticks - execution_counter) * 1000 / static_cast<long double>(cpuid_get_TSC_frequency());
-    sleep_timers.iterate([elapsed_ms](sleep_timer_t* t) { t->counter -= elapsed_ms; });
     execution_counter = ticks;
-    while (true) // until all counters less than 0 are accounted for
+    while (!sleep_timers.empty() && sleep_timers.top().deadline <= ticks)
     {
-        sleep_timer_t* timer = sleep_timers.find_if([](const sleep_timer_t& t) { return t.counter <= 0; });
-        if (timer == nullptr) return;
-        const size_t pid = timer->pid;
-        sleep_timers.remove(timer);
+        const size_t pid = sleep_timers.top().pid;
+        sleep_timers.pop();
         if (processes[pid].state == Process::STATE_SLEEPING)
         {
-            processes[pid].state = Process::STATE_READY;
+            processes[pid].sleep_ticks += ticks - processes[pid].wait_started;
+            trace(SCHED_TRACE_WAKE, pid, 0);
+            make_ready(pid);
         }
     }
 }
 
 void Scheduler::handle_exited_threads()
 {
-    for (size_t i = 0; i <= highest_assigned_pid; i++)
+    while (exited_head != nullptr)
     {
-        if (processes[i].state == Process::STATE_EXITED)
+        Process* proc = exited_head;
+        exited_head = proc->next_queued;
+        const size_t i = proc - processes;
+        if (proc->user)
         {
-            if (processes[i].user)
-            {
-                art_free(processes[i].stack);
-            }
-            processes[i].reset(); // cleans up event queue.
-            if (i == highest_assigned_pid)
-            {
-                highest_assigned_pid = getMaxAliveProcessID();
-            }
+            art_free(proc->stack);
+        }
+        if (proc->paging_table != nullptr)
+        {
+            // The exiting process may be the one whose directory is still loaded, so move off it before it is freed.
+            if ((get_cr3() & ~(page_alignment - 1)) == proc->cr3_val) set_cr3(kernel_pages().get_phys_addr_of_page_dir());
+            delete proc->paging_table;
+            proc->paging_table = nullptr;
+        }
+        proc->reset(); // cleans up event queue.
+        if (i == highest_assigned_pid)
+        {
+            highest_assigned_pid = getMaxAliveProcessID();
         }
     }
 }
 
-// Walk the IO queue and initalises and finish any queued events. Events are always appended in order.
-void Scheduler::handle_io()
+// Head of the highest priority non-empty ready queue, or the idle task. The process is not dequeued.
+size_t Scheduler::get_next_process_id()
 {
-    auto* entry = IO_Queue.head();
-    while (entry)
+    for (const Process* head : ready_heads)
     {
-        switch (auto [pid, operation] = entry->data; operation->state())
-        {
-        case IO_operation::READY:
-            {
-            ready:
-                operation->do_op();
-                // some operations can be immediate
-                if (operation->state() == IO_operation::DONE)
-                {
-                    goto done;
-                }
-                break;
-            }
-        case IO_operation::DONE:
-            {
-            done:
-                processes[pid].state = Process::STATE_READY;
-                const auto next = entry->next;
-                IO_Queue.remove(&entry->data);
-                entry = next;
-                continue;
-            }
-        default:
-            break;
-        }
-        entry = entry->next;
+        if (head != nullptr) return head - processes;
     }
+    return idle_process_id;
 }
 
-size_t Scheduler::get_next_process_id()
+/**
+ * Move a process to another priority class. Higher classes always run first and get longer time slices.
+ * @param priority one of Process::Priority_t
+ * @return 0 on success or -1 if the process or priority is not valid
+ */
+int Scheduler::set_priority(const size_t pid, const int priority)
 {
-    size_t ret_id = 0;
-    u64 lowest = -1;
-    for (size_t i = 2; i <= highest_assigned_pid; i++)
+    if (pid >= max_processes || pid == idle_process_id || processes[pid].isDead()) return -1;
+    if (priority != Process::PRIORITY_LOW && priority != Process::PRIORITY_NORMAL && priority != Process::PRIORITY_HIGH)
     {
-        if (processes[i].state != Process::STATE_READY) continue;
-        if (processes[i].last_executed < lowest)
-        {
-            ret_id = i;
-            lowest = processes[i].last_executed;
-        }
+        return -1;
     }
-    if (ret_id == 0) return 1;
-    return ret_id;
+    Process* proc = &processes[pid];
+    const bool was_queued = proc->queued;
+    dequeue_ready(proc);
+    proc->priority = static_cast<Process::Priority_t>(priority);
+    if (was_queued) enqueue_ready(proc);
+    return 0;
 }
 
 void Scheduler::sleep_ms(cpu_registers_t* r)
 {
     const size_t ms = r->ebx;
-    sleep_timers.append(sleep_timer_t{current_process_id, ms});
-    processes[current_process_id].state = Process::STATE_SLEEPING;
     execution_counter = TSC_get_ticks();
+    const u64 deadline = execution_counter + ms * (cpuid_get_TSC_frequency() / 1000);
+    if (!sleep_timers.push(sleep_timer_t{deadline, current_process_id})) return; // cannot happen, one timer per process
+    make_waiting(current_process_id, Process::STATE_SLEEPING);
+    trace(SCHED_TRACE_SLEEP, current_process_id, ms);
     processes[current_process_id].last_executed = execution_counter;
     schedule(r);
 }
 
+/**
+ * Start a read for the current process. If the device cannot finish it straight away the process is parked until the
+ * device interrupt completes it, see io_complete, otherwise the result is returned without a context switch.
+ */
 void Scheduler::append_read(cpu_registers_t* r)
 {
-    processes[current_process_id].state = Process::STATE_PARKED;
+    trace(SCHED_TRACE_IO_START, current_process_id, r->ebx);
     // Pass the pointer to context eax here because we will store the return value in r->eax but
     // this r->eax is ephemeral. context.eax is loaded on context switch
     const auto ret = reinterpret_cast<int*>(&processes[current_process_id].context.eax);
     auto* op = new IO_read(ret, static_cast<int>(r->ebx), reinterpret_cast<char*>(r->ecx), r->edx);
-    const io_queue_entry_t entry = {
-        current_process_id,
-        op
-    };
-    IO_Queue.append(entry);
+    op->process_id = current_process_id;
+    op->on_done = &io_complete;
+    submitting_io = op;
+    if (op->state() == IO_operation::READY) op->do_op();
+    submitting_io = nullptr;
+    if (op->state() != IO_operation::DONE)
+    {
+        make_waiting(current_process_id, Process::STATE_PARKED);
+        schedule(r);
+        return;
+    }
+    trace(SCHED_TRACE_IO_COMPLETE, current_process_id, 0);
+    r->eax = *op->result;
+    delete op;
+}
+
+/* Completion callback of reads which had to wait. Runs in the device interrupt handler. */
+void Scheduler::io_complete(IO_operation* op)
+{
+    if (op == submitting_io) return; // finished inside append_read, which returns the result itself
+    const size_t pid = op->process_id;
+    delete op;
+    if (processes[pid].state != Process::STATE_PARKED) return; // killed while the read was in flight
+    processes[pid].io_wait_ticks += TSC_get_ticks() - processes[pid].wait_started;
+    trace(SCHED_TRACE_IO_COMPLETE, pid, 0);
+    make_ready(pid);
+    io_woken = true;
+}
+
+/**
+ * Called at the end of a device interrupt. If the interrupt made a process ready while the idle task was running then
+ * switch to it now, because no timer may be armed to do it. A running process keeps the rest of its time slice.
+ */
+void Scheduler::wake_from_interrupt(cpu_registers_t* r)
+{
+    if (!io_woken) return;
+    io_woken = false;
+    if (current_process_id != idle_process_id) return;
+    ++sched_stats.io_wakeups;
+    preempting = true;
     schedule(r);
+    preempting = false;
+}
+
+/**
+ * Length of the next one-shot: the time slice, cut short if a sleeping process is due to wake before it ends.
+ * @param slice_us time slice of the process about to run
+ */
+u32 Scheduler::next_oneshot_us(const u32 slice_us)
+{
+    if (sleep_timers.empty()) return slice_us;
+    const u64 now = TSC_get_ticks();
+    const u64 deadline = sleep_timers.top().deadline;
+    if (deadline <= now) return min_oneshot_us;
+    const u64 ticks_per_us = MAX(cpuid_get_TSC_frequency() / 1000000, 1);
+    const u64 until_us = (deadline - now + ticks_per_us - 1) / ticks_per_us;
+    return static_cast<u32>(MAX(MIN(until_us, static_cast<u64>(slice_us)), static_cast<u64>(min_oneshot_us)));
+}
+
+/**
+ * Length of the one-shot to arm while idle: the time until the next sleeping process is due, or 0 if nothing can
+ * become ready without an interrupt and no timer is needed. I/O completion wakes the CPU through the device interrupt.
+ */
+u32 Scheduler::idle_oneshot_us()
+{
+    if (sleep_timers.empty()) return 0;
+    return next_oneshot_us(max_idle_oneshot_us);
+}
+
+// Program the timer for the next real event only, instead of a time slice, because the idle task can be preempted
+// at any time anyway.
+void Scheduler::enter_idle()
+{
+    idle_entered_ticks = execution_counter;
+    ++sched_stats.idle_entries;
+    if (const u32 time_us = idle_oneshot_us(); time_us > 0)
+    {
+        start_oneshot(time_us);
+    }
+    else
+    {
+        lapic_timer->stop_timer();
+        ++sched_stats.tickless_entries;
+    }
+}
+
+// Idle residency, and how many time slices passed while idle which would each have been a timer interrupt before.
+void Scheduler::leave_idle()
+{
+    const u64 idle_ticks = execution_counter - idle_entered_ticks;
+    sched_stats.idle_ticks += idle_ticks;
+    const u64 ticks_per_us = sched_stats.tsc_frequency / 1000000;
+    const u64 slice_ticks = MAX(context_switch_period_us * Process::PRIORITY_LOW * ticks_per_us, 1);
+    if (const u64 slices = idle_ticks / slice_ticks; slices > 1) sched_stats.ticks_skipped += slices - 1;
+}
+
+void Scheduler::get_stats(sched_stats_t* dest)
+{
+    art_string::memcpy(dest, &sched_stats, sizeof(sched_stats_t));
+    dest->total_ticks = TSC_get_ticks() - scheduler_start_ticks;
+}
+
+void Scheduler::log_stats()
+{
+    sched_stats_t stats;
+    get_stats(&stats);
+    LOG("scheduler ticks: ", stats.total_ticks, " idle: ", stats.idle_ticks);
+    LOG("timer interrupts: ", stats.timer_interrupts, " skipped: ", stats.ticks_skipped);
+    LOG("idle entries: ", stats.idle_entries, " tickless: ", stats.tickless_entries);
+    LOG("i/o wakeups: ", stats.io_wakeups);
+    LOG("fpu traps: ", stats.fpu_traps, " saves: ", stats.fpu_saves);
+}
+
+/** Per-process CPU accounting for every live process and the newest trace events. */
+void Scheduler::get_report(sched_report_t* dest)
+{
+    dest->n_processes = 0;
+    for (size_t pid = 0; pid <= highest_assigned_pid && dest->n_processes < SCHED_REPORT_MAX_PROCESSES; pid++)
+    {
+        const Process* proc = &processes[pid];
+        if (proc->state == Process::STATE_DEAD) continue;
+        process_stats_t* stats = &dest->processes[dest->n_processes++];
+        stats->pid = pid;
+        art_string::memcpy(stats->name, proc->name, sizeof(stats->name));
+        stats->name[sizeof(stats->name) - 1] = '\0';
+        switch (proc->state)
+        {
+        case Process::STATE_SLEEPING: stats->state = 'S';
+            break;
+        case Process::STATE_PARKED: stats->state = 'P';
+            break;
+        case Process::STATE_EXITED: stats->state = 'X';
+            break;
+        default: stats->state = 'R';
+            break;
+        }
+        stats->priority = proc->priority;
+        stats->run_ticks = proc->run_ticks;
+        // Include the time so far of whatever is in progress so a long sleep or the caller itself show up.
+        if (pid == current_process_id) stats->run_ticks += TSC_get_ticks() - proc->run_started;
+        stats->io_wait_ticks = proc->io_wait_ticks;
+        stats->sleep_ticks = proc->sleep_ticks;
+        if (proc->state == Process::STATE_SLEEPING) stats->sleep_ticks += TSC_get_ticks() - proc->wait_started;
+        stats->preemptions = proc->preemptions;
+        stats->yields = proc->yields;
+    }
+    dest->n_trace = sched_trace.read_latest(dest->trace, SCHED_REPORT_MAX_TRACE);
+    dest->trace_total = sched_trace.total();
 }
 
 void Scheduler::start_oneshot(u32 time_us)
@@ -290,15 +541,58 @@ void Scheduler::store_current_context(cpu_registers_t* r, const size_t PID)
     art_string::memcpy(&processes[PID].context, r, sizeof(cpu_registers_t));
 }
 
+/**
+ * Device-not-available (#NM) handler. The current process touched the FPU while another one's registers were loaded, so
+ * swap them over now rather than on every context switch.
+ * @return false if lazy switching is not in use and the trap is a real error
+ */
+bool Scheduler::handle_fpu_unavailable()
+{
+    if (!lazy_fpu) return false;
+    fpu_clear_task_switched();
+    ++sched_stats.fpu_traps;
+    if (fpu_owner == current_process_id) return true;
+    if (fpu_owner < max_processes)
+    {
+        fpu_save(&processes[fpu_owner].fpu_state);
+        ++sched_stats.fpu_saves;
+    }
+    Process* proc = &processes[current_process_id];
+    if (proc->fpu_used)
+    {
+        fpu_restore(&proc->fpu_state);
+    }
+    else
+    {
+        fpu_init();
+        proc->fpu_used = true;
+    }
+    fpu_owner = current_process_id;
+    return true;
+}
+
 void Scheduler::set_current_context(cpu_registers_t* r, size_t PID)
 {
     art_string::memcpy(r, &processes[PID].context, sizeof(cpu_registers_t));
-    asm volatile("mov %0, %%cr3" :: "r"(processes[PID].cr3_val) : "memory");
+    // Only the owner may use the FPU without trapping first, see handle_fpu_unavailable.
+    if (lazy_fpu)
+    {
+        if (PID == fpu_owner) fpu_clear_task_switched();
+        else fpu_set_task_switched();
+    }
+    // Kernel mappings are global and survive a CR3 write but user mappings do not, so only reload it when the
+    // directory changes. The idle task only touches the kernel half, which every directory maps, so it keeps whichever
+    // directory was loaded last.
+    if (PID == idle_process_id || (get_cr3() & ~(page_alignment - 1)) == processes[PID].cr3_val) return;
+    set_cr3(processes[PID].cr3_val);
 }
 
 void LAPIC_handler(cpu_registers_t* const r)
 {
+    ++sched_stats.timer_interrupts;
+    preempting = true;
     Scheduler::schedule(r);
+    preempting = false;
 }
 
 // Exit is called by the program to tell the OS it is done.
@@ -306,11 +600,11 @@ void Scheduler::exit(cpu_registers_t* const r)
 {
     u32 status = r->ebx;
     LOG("Exiting ", processes[current_process_id].name, " PID: ", current_process_id, " with status: ", status);
-    processes[current_process_id].state = Process::STATE_EXITED;
+    make_exited(current_process_id);
     auto parent_id = processes[current_process_id].parent_pid;
     if (processes[parent_id].state == Process::STATE_PARKED)
     {
-        processes[parent_id].state = Process::STATE_READY;
+        make_ready(parent_id);
         processes[parent_id].context.eax = status;
     }
     LOG("Post-exit process ID:", get_next_process_id());
@@ -320,11 +614,11 @@ void Scheduler::exit(cpu_registers_t* const r)
 // Kill is supposed to send a command to the process to tell it to exit.
 void Scheduler::kill(size_t target_pid)
 {
-    processes[target_pid].state = Process::STATE_EXITED;
+    make_exited(target_pid);
     auto parent_id = processes[current_process_id].parent_pid;
     if (processes[parent_id].state == Process::STATE_PARKED)
     {
-        processes[parent_id].state = Process::STATE_READY;
+        make_ready(parent_id);
     }
     // ???? what do here? I cannot switch because then it never returns?
     // switch_process(r, getNextProcessID());
@@ -410,8 +704,9 @@ void Scheduler::execute_from_paging_table(PagingTableUser* PTU, const char* name
     proc->cr3_val = proc->paging_table->get_phys_addr_of_page_dir();
     proc->last_executed = TSC_get_ticks();
     proc->start(parent_process_id, context, proc_stack, name, true);
+    make_ready(next_process_id);
 
-    processes[parent_process_id].state = Process::STATE_PARKED;
+    make_waiting(parent_process_id, Process::STATE_PARKED);
 }
 
 PagingTableUser& Scheduler::getCurrentPagingTable()
@@ -419,6 +714,13 @@ PagingTableUser& Scheduler::getCurrentPagingTable()
     return *processes[current_process_id].paging_table;
 }
 
+/** @return the current process's paging table or nullptr if it is a kernel task */
+PagingTableUser* Scheduler::getCurrentUserPagingTable()
+{
+    if (!processes[current_process_id].user) return nullptr;
+    return processes[current_process_id].paging_table;
+}
+
 size_t Scheduler::getCurrentProcessID()
 {
     return current_process_id;
@@ -32,6 +32,8 @@ constexpr size_t max_processes = 255;
 
 class EventQueue;
 class PagingTableUser;
+struct sched_stats_t;
+struct sched_report_t;
 
 class Scheduler
 {
@@ -50,25 +52,36 @@ public:
     static void execute_from_paging_table(PagingTableUser* PTU, const char* name_loc, uintptr_t entry_point,
                                           uintptr_t stack_vaddr, uintptr_t stack_size);
     PagingTableUser& getCurrentPagingTable();
+    static PagingTableUser* getCurrentUserPagingTable();
 
     static size_t getCurrentProcessID();
     static EventQueue* getCurrentProcessEventQueue();
     static uintptr_t getCurrentProcessPagingDirectory();
     static size_t getNextProcessID();
+    static int set_priority(size_t pid, int priority);
+    static u32 next_oneshot_us(u32 slice_us);
     static void start_oneshot(u32 time_us);
+    static void get_stats(sched_stats_t* dest);
+    static void log_stats();
+    static void get_report(sched_report_t* dest);
+    static bool handle_fpu_unavailable();
     static void schedule(cpu_registers_t* r);
 
     // static void schedule();
 
     static void sleep_ms(cpu_registers_t* r);
     static void append_read(cpu_registers_t* r);
+    static void wake_from_interrupt(cpu_registers_t* r);
 
 private:
     static void create_idle_task();
 
     static void handle_exited_threads();
-    static void handle_io();
+    static void io_complete(IO_operation* op);
     static size_t get_next_process_id();
+    static u32 idle_oneshot_us();
+    static void enter_idle();
+    static void leave_idle();
     static void switch_process(cpu_registers_t* r, size_t new_PID);
     static void store_current_context(cpu_registers_t* r, size_t PID);
     static void set_current_context(cpu_registers_t* r, size_t PID);
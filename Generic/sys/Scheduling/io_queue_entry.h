@@ -21,6 +21,7 @@
 #ifndef IO_QUEUE_ENTRY_H
 #define IO_QUEUE_ENTRY_H
 #include <_types.h>
+#include <StorageDevice.h>
 
 struct cpu_registers_t;
 
@@ -33,6 +34,9 @@ enum WaitingReason_t
 };
 
 
+class IO_operation;
+typedef void (*io_done_t)(IO_operation* op);
+
 class IO_operation
 {
 public:
@@ -50,6 +54,10 @@ public:
     virtual void do_op() = 0;
     int* result;
     IO_State _state;
+    size_t process_id = 0;
+    // Called once an operation which went IN_PROGRESS has finished, usually from a device interrupt. The operation may
+    // be deleted by it.
+    io_done_t on_done = nullptr;
 };
 
 class IO_read final : public IO_operation
@@ -60,17 +68,14 @@ public:
     void do_op() override;
 
 private:
+    void release_buffer();
+    static void complete(io_request_t* request);
+
+    io_request_t request{};
     int _fd;
     char* _buf;
     char* _k_buf;
     size_t _count;
 };
 
-struct io_queue_entry_t
-{
-    size_t process_id = 0;
-    IO_operation* op = nullptr;
-};
-
-
 #endif //IO_QUEUE_ENTRY_H
@@ -0,0 +1,161 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#include "BlockCache.h"
+
+#include "cache_stats.h"
+#include "logging.h"
+#include "memory.h"
+#include "paging.h"
+
+static BlockCache cache;
+
+BlockCache& block_cache()
+{
+    return cache;
+}
+
+/**
+ * Allocate the cache. With no memory, or a capacity under one extent, the cache stays disabled and devices read
+ * without it.
+ * @return true if the cache holds at least one extent
+ */
+bool BlockCache::init(const size_t capacity_bytes)
+{
+    const size_t n_extents = capacity_bytes / extent_bytes;
+    if (n_extents == 0 || enabled()) return enabled();
+    auto* new_data = static_cast<char*>(kmmap(0, n_extents * extent_bytes, PAGING_WRITABLE, 0, 0, 0));
+    if (new_data == nullptr)
+    {
+        LOG("Block cache: no memory for ", n_extents, " extents, reading uncached.");
+        return false;
+    }
+    void* index_storage = art_alloc(LRUIndex::storage_bytes(n_extents) + n_extents * sizeof(extent_state_t), 8);
+    if (index_storage == nullptr)
+    {
+        kmunmap(new_data, n_extents * extent_bytes);
+        LOG("Block cache: no memory for the index, reading uncached.");
+        return false;
+    }
+    data = new_data;
+    states = reinterpret_cast<extent_state_t*>(static_cast<char*>(index_storage) + LRUIndex::storage_bytes(n_extents));
+    index.init(index_storage, n_extents);
+    LOG("Block cache: ", n_extents, " extents of ", extent_bytes, " bytes.");
+    return true;
+}
+
+/* Number for a new device's keys, so that devices can share the cache. */
+u32 BlockCache::add_device()
+{
+    return n_devices++;
+}
+
+/* Count hits and misses for a read covering first_extent to last_extent, once per read however it is then filled. */
+void BlockCache::account(const u32 device, const size_t first_extent, const size_t last_extent)
+{
+    for (size_t extent = first_extent; extent <= last_extent; extent++)
+    {
+        const size_t slot = index.peek(key(device, extent));
+        if (slot == LRU_ERR_IDX || states[slot] == EXTENT_PENDING)
+        {
+            misses++;
+            continue;
+        }
+        hits++;
+        if (states[slot] == EXTENT_PREFETCHED)
+        {
+            readahead_hits++;
+            states[slot] = EXTENT_VALID;
+        }
+    }
+}
+
+/** @return the cached extent, now the most recently used, or nullptr if it is not cached */
+char* BlockCache::lookup(const u32 device, const size_t extent)
+{
+    const size_t slot = index.find(key(device, extent));
+    if (slot == LRU_ERR_IDX || states[slot] == EXTENT_PENDING) return nullptr;
+    return &data[slot * extent_bytes];
+}
+
+bool BlockCache::contains(const u32 device, const size_t extent) const
+{
+    const size_t slot = index.peek(key(device, extent));
+    return slot != LRU_ERR_IDX && states[slot] != EXTENT_PENDING;
+}
+
+/**
+ * Take a slot for an extent which is about to be read from the device, evicting the least recently used if needed.
+ * The slot is pinned so that no other fill can reuse it while the device writes into it, and the extent is not
+ * visible to lookup until it is committed.
+ * @return memory for extent_bytes of data, or nullptr if the cache is disabled, every slot is being filled or the
+ * extent is already being filled
+ */
+char* BlockCache::reserve(const u32 device, const size_t extent)
+{
+    if (const size_t existing = index.peek(key(device, extent)); existing != LRU_ERR_IDX && index.is_pinned(existing))
+    {
+        return nullptr;
+    }
+    bool evicted = false;
+    const size_t slot = index.insert(key(device, extent), &evicted);
+    if (slot == LRU_ERR_IDX) return nullptr;
+    if (evicted) evictions++;
+    index.pin(slot);
+    states[slot] = EXTENT_PENDING;
+    return &data[slot * extent_bytes];
+}
+
+/* The fill of a reserved extent completed. */
+void BlockCache::commit(const u32 device, const size_t extent, const bool readahead)
+{
+    const size_t slot = index.peek(key(device, extent));
+    if (slot == LRU_ERR_IDX) return;
+    index.unpin(slot);
+    states[slot] = readahead ? EXTENT_PREFETCHED : EXTENT_VALID;
+    if (readahead) readahead_extents++;
+}
+
+/* The fill of a reserved extent failed, or its contents are stale. */
+void BlockCache::drop(const u32 device, const size_t extent)
+{
+    if (const size_t slot = index.peek(key(device, extent)); slot != LRU_ERR_IDX) index.erase(slot);
+}
+
+void BlockCache::get_stats(cache_stats_t* dest) const
+{
+    dest->extent_bytes = extent_bytes;
+    dest->capacity_extents = index.get_capacity();
+    dest->used_extents = index.get_used();
+    dest->hits = hits;
+    dest->misses = misses;
+    dest->evictions = evictions;
+    dest->fills = fills;
+    dest->readahead_extents = readahead_extents;
+    dest->readahead_hits = readahead_hits;
+}
+
+void BlockCache::log_stats() const
+{
+    const unsigned long total = hits + misses;
+    LOG("Block cache: ", index.get_used(), "/", index.get_capacity(), " extents, ", hits, " hits ", misses,
+        " misses (", total ? hits * 100 / total : 0, "% hit rate), ", evictions, " evictions, ", fills, " fills");
+    LOG("Block cache readahead: ", readahead_extents, " extents prefetched, ", readahead_hits, " read");
+}
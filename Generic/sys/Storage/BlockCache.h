@@ -0,0 +1,80 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#ifndef BLOCKCACHE_H
+#define BLOCKCACHE_H
+
+#include "types.h"
+#include "LRUIndex.h"
+
+struct cache_stats_t;
+
+/*
+ * Shared cache of disk contents in extents of extent_bytes, keyed by (device, extent number) and evicted least recently
+ * used first. A device fills an extent by reserving its slot, pointing a transfer at the returned memory and then
+ * committing or dropping it. Only one fill per device is outstanding at a time and everything runs with interrupts
+ * disabled or before the scheduler starts, so there is no locking.
+ */
+class BlockCache
+{
+public:
+    static constexpr size_t extent_bytes = 65536;
+
+    bool init(size_t capacity_bytes);
+    [[nodiscard]] bool enabled() const { return index.get_capacity() > 0; }
+    [[nodiscard]] size_t capacity() const { return index.get_capacity(); }
+    u32 add_device();
+
+    void account(u32 device, size_t first_extent, size_t last_extent);
+    char* lookup(u32 device, size_t extent);
+    [[nodiscard]] bool contains(u32 device, size_t extent) const;
+    char* reserve(u32 device, size_t extent);
+    void commit(u32 device, size_t extent, bool readahead);
+    void drop(u32 device, size_t extent);
+    void count_fill() { fills++; }
+
+    void get_stats(cache_stats_t* dest) const;
+    void log_stats() const;
+
+private:
+    enum extent_state_t : u8
+    {
+        EXTENT_PENDING,
+        EXTENT_VALID,
+        EXTENT_PREFETCHED, // valid and not read since the readahead which filled it
+    };
+
+    static u64 key(const u32 device, const size_t extent) { return static_cast<u64>(device) << 32 | extent; }
+
+    LRUIndex index;
+    char* data = nullptr;
+    extent_state_t* states = nullptr;
+    u32 n_devices = 0;
+    unsigned long hits = 0;
+    unsigned long misses = 0;
+    unsigned long evictions = 0;
+    unsigned long fills = 0;
+    unsigned long readahead_extents = 0;
+    unsigned long readahead_hits = 0;
+};
+
+BlockCache& block_cache();
+
+#endif //BLOCKCACHE_H
@@ -25,6 +25,22 @@
 #include "CPPMemory.h"
 class ArtFile;
 
+struct io_request_t;
+typedef void (*io_complete_t)(io_request_t* request);
+
+// One asynchronous read, owned by the submitter until on_complete has been called.
+struct io_request_t
+{
+    char* dest; // kernel mapped for the whole request
+    size_t byte_offset; // position on the device
+    size_t n_bytes;
+    size_t bytes_done = 0;
+    i64 result = 0; // bytes read or an error, set before on_complete
+    io_complete_t on_complete = nullptr; // called once, possibly from an interrupt handler or before submit returns
+    void* context = nullptr; // for on_complete
+    io_request_t* next = nullptr; // device queue
+};
+
 class StorageDevice
 {
 public:
@@ -32,12 +48,12 @@ public:
 
     virtual i64 read(char* dest, size_t byte_offset, size_t byte_count) = 0;
 
-    virtual i64 async_read(char* dest, size_t byte_offset, size_t byte_count) = 0;
+    /* Queue a read. Returns 0 once queued or -1 if the device only reads synchronously. */
+    virtual int submit_read(io_request_t* request) = 0;
 
+    /* True while a synchronous read or write is using the device. */
     virtual bool device_busy() = 0;
 
-    virtual i64 async_n_read() = 0;
-
     virtual i64 seek(u64 byte_offset, int whence) = 0;
 
     virtual i64 write(const char* src, size_t byte_offset, size_t byte_count) = 0;
@@ -40,14 +40,15 @@ typedef int (*readFunc)();
 typedef int (*seekFunc)();
 typedef int (*writeFunc)();
 
+// The transfer in flight, which belongs to current_request unless it is a readahead.
 struct dma_read_context {
-    char* user_buffer;      // where the caller wants the full data
-    size_t total_size;         // total size requested
-    size_t bytes_read;         // how much we have read so far
-    i64 byte_offset;
     size_t lba_offset;
-    bool busy = true; // indicates all data transferred
-    // any synchronization primitives like a semaphore or event if needed
+    size_t direct_bytes; // non-zero if the transfer in flight goes straight into the request's buffer instead of the bounce region
+    size_t bounce_sectors; // otherwise, the number of sectors going into the bounce region
+    size_t cache_extent; // or the first block cache extent being filled
+    size_t cache_extents; // non-zero if the transfer in flight fills the block cache
+    bool readahead; // the transfer in flight is a prefetch which nobody is waiting for
+    bool busy = true; // a transfer is in flight
 };
 
 class IDEStorageContainer : public IDE_notifiable, public StorageDevice {
@@ -61,9 +62,8 @@ public:
 
     void async_notify();
 
-    i64 async_read(char* dest, size_t byte_offset, size_t n_bytes) override;
+    int submit_read(io_request_t* request) override;
     bool device_busy() override;
-    i64 async_n_read() override;
     i64 read(void* dest, size_t byte_offset, size_t n_bytes);
     i64 read_lba(void* dest, size_t lba_offset, size_t n_bytes);
     i64 seek([[maybe_unused]] u64 offset, [[maybe_unused]] int whence) override { return -NOT_IMPLEMENTED; }
@@ -78,7 +78,8 @@ public:
     void start_DMA_transfer();
     [[nodiscard]] int wait_for_DMA_transfer() const;
     int stop_DMA_read();
-    int read_into_region_from_lba(size_t lba_offset);
+    int read_into_region_from_lba(size_t lba_offset, size_t n_sectors);
+    int read_direct_from_lba(size_t lba_offset, size_t n_sectors);
 
 
     void notify() override;
@@ -88,6 +89,26 @@ public:
 
 private:
     // priavte member functions
+    i64 read_cached(char* dest, size_t byte_offset, size_t n_bytes);
+    i64 read_uncached(char* dest, size_t byte_offset, size_t n_bytes);
+    u64 disk_bytes();
+    size_t copy_from_cache(char* dest, size_t byte_offset, size_t n_bytes);
+    size_t uncached_run(size_t first_extent, size_t last_extent);
+    size_t target_cache_fill(size_t first_extent, size_t n_extents, bool readahead);
+    void end_cache_fill(bool ok);
+    int read_into_cache(size_t first_extent, size_t last_extent);
+    void finish_transfer();
+    void note_read(size_t byte_offset, size_t n_bytes);
+    void start_readahead();
+    void queue_request(io_request_t* request);
+    io_request_t* next_request();
+    void finish_request(io_request_t* request, i64 result);
+    void serve_cached_requests();
+    void start_next_transfer();
+    size_t bounce_sectors(size_t byte_offset, size_t n_bytes);
+    size_t target_direct(char* dest, size_t n_bytes);
+    size_t target_bypass(char* dest, size_t byte_offset, size_t n_bytes);
+    int start_async_transfer();
     DirectoryData dir_record_to_directory(const iso_directory_record_header& info, char*& name);
     FileData dir_record_to_file(const iso_directory_record_header& info, char*& name);
 
@@ -109,8 +130,16 @@ private:
     ArtDirectory* root_directory = nullptr;
     volatile bool BM_waiting_for_transfer = false; // todo private member
     i64 stored_buffer_start = -1;
-    bool busy = false;
+    i64 stored_buffer_size = 0; // bytes of the region holding data from stored_buffer_start
+    bool busy = false; // a synchronous read has the device
     dma_read_context dma_context = {};
+    io_request_t* current_request = nullptr; // request being transferred, taken off the queue
+    io_request_t* queued_requests = nullptr; // waiting, in ascending byte_offset
+    size_t elevator_position = 0; // byte offset the last transfer started from
+    u32 cache_device = 0; // this device's keys in the block cache
+    size_t next_sequential_offset = 0; // where the last read ended
+    u32 sequential_reads = 0; // reads in a row which started where the one before ended
+    bool readahead_wanted = false; // prefetch once the queue is empty
 };
 
 #endif //IDE_DEVICE_H
@@ -83,7 +83,7 @@ u16 get_ds()
 cr0_t get_cr0()
 {
     cr0_t cr0{};
-    asm("mov %%cr0,%0" : "=r"(cr0.raw));
+    asm volatile("mov %%cr0,%0" : "=r"(cr0.raw));
     return cr0;
 }
 
@@ -96,7 +96,64 @@ u32 get_cr2()
 
 
 
+u32 get_cr3()
+{
+    u32 cr3;
+    asm volatile("mov %%cr3,%0" : "=r"(cr3));
+    return cr3;
+}
+
 void set_cr3(uintptr_t addr)
 {
     asm volatile("mov %0, %%cr3" :: "r"(addr) : "memory");
 }
+
+u32 get_cr4()
+{
+    u32 cr4;
+    asm volatile("mov %%cr4,%0" : "=r"(cr4));
+    return cr4;
+}
+
+void set_cr4(u32 cr4)
+{
+    asm volatile("mov %0, %%cr4" :: "r"(cr4) : "memory");
+}
+
+void invlpg(uintptr_t addr)
+{
+    asm volatile("invlpg (%0)" :: "r"(addr) : "memory");
+}
+
+void fpu_save(fpu_state_t* dest)
+{
+    asm volatile("fxsave (%0)" :: "r"(dest) : "memory");
+}
+
+void fpu_restore(const fpu_state_t* src)
+{
+    asm volatile("fxrstor (%0)" :: "r"(src) : "memory");
+}
+
+/* Power-on x87 state and, if SSE is enabled, the default MXCSR (all SSE exceptions masked, round to nearest). */
+void fpu_init()
+{
+    constexpr u32 default_mxcsr = 0x1f80;
+    asm volatile("fninit");
+    if (get_cr4() & 1 << 9) asm volatile("ldmxcsr %0" :: "m"(default_mxcsr));
+}
+
+/* The next x87, MMX or SSE instruction raises #NM (vector 7). MP makes WAIT/FWAIT trap as well. */
+void fpu_set_task_switched()
+{
+    cr0_t cr0 = get_cr0();
+    if (cr0.TS && cr0.MP) return;
+    cr0.TS = 1;
+    cr0.MP = 1;
+    asm volatile("mov %0, %%cr0" :: "r"(cr0.raw) : "memory");
+}
+
+void fpu_clear_task_switched()
+{
+    asm volatile("clts");
+}
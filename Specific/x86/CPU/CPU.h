@@ -109,6 +109,12 @@ union cr0_t
     u32 raw;
 };
 
+// FXSAVE image of the x87, MMX and SSE registers. FXSAVE and FXRSTOR need it 16 byte aligned.
+struct fpu_state_t
+{
+    u8 data[512];
+} __attribute__((aligned(16)));
+
 eflags_t get_eflags();
 bool get_interrupts_are_enabled();
 
@@ -129,6 +135,15 @@ cr0_t get_cr0();
 u32 get_cr2();
 u32 get_ebp();
 u32 set_ebp(u32 ebp);
+u32 get_cr3();
 void set_cr3(uintptr_t addr);
+u32 get_cr4();
+void set_cr4(u32 cr4);
+void invlpg(uintptr_t addr);
+void fpu_save(fpu_state_t* dest);
+void fpu_restore(const fpu_state_t* src);
+void fpu_init();
+void fpu_set_task_switched();
+void fpu_clear_task_switched();
 
 #endif //SYSTEM_H
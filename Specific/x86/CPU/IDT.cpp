@@ -165,6 +165,10 @@ void __attribute__((section(".trampoline.text"))) handle_div_by_zero(const cpu_r
 extern "C"
 void __attribute__((section(".trampoline.text"))) exception_handler(cpu_registers_t* const r)
 {
+    // FPU used by a process which does not own its registers yet: swap them in and retry the instruction.
+    if (r->int_no == 7 && Scheduler::handle_fpu_unavailable()) return;
+    // First touch of a demand-zero user page: map it and retry the instruction.
+    if (r->int_no == 14 && user_page_fault(get_cr2(), r->err_code)) return;
     log_registers(r);
     if (already_killing)
     {
@@ -251,9 +255,11 @@ void __attribute__((section(".trampoline.text"))) irq_handler(cpu_registers_t* c
             break;
         case IDE_PRIMARY_IRQ:
             IDE_handler(true);
+            Scheduler::wake_from_interrupt(r);
             break;
         case IDE_SECONDARY_IRQ:
             IDE_handler(false);
+            Scheduler::wake_from_interrupt(r);
             break;
         case LAPIC_IRQ:
             LAPIC_handler(r);
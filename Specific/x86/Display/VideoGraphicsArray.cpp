@@ -49,6 +49,7 @@ Basic graphics utility methods
 #include "colours.h"
 
 #include "memory.h"
+#include "TSC.h"
 
 
 static VideoGraphicsArray* instance{nullptr};
@@ -208,6 +209,32 @@ void VideoGraphicsArray::drawRegion(const u32* buffer_to_draw) const
     memcpy(_screen, buffer_to_draw, width * height * sizeof(u32));
 }
 
+/*
+ * Times n_frames full screen blits through the framebuffer's own mapping, which uses 4MiB pages when they are available,
+ * and then through a temporary 4KiB mapping of the same memory so the TLB cost of the two can be compared.
+ */
+void VideoGraphicsArray::benchmarkBlit(const size_t n_frames) const
+{
+    const size_t n_bytes = width * height * sizeof(u32);
+    u64 start = TSC_get_ticks();
+    for (size_t i = 0; i < n_frames; i++) drawRegion(_buffer);
+    const u64 direct_ticks = (TSC_get_ticks() - start) / n_frames;
+
+    auto* small_pages = static_cast<u32*>(kmap_physical(kget_mapping_target(_screen), n_bytes));
+    if (small_pages == nullptr)
+    {
+        LOG("Blit benchmark: ", direct_ticks, " ticks per frame");
+        return;
+    }
+    start = TSC_get_ticks();
+    for (size_t i = 0; i < n_frames; i++) memcpy(small_pages, _buffer, n_bytes);
+    const u64 small_ticks = (TSC_get_ticks() - start) / n_frames;
+    kunmap_physical(small_pages, n_bytes);
+
+    LOG("Blit benchmark: ", direct_ticks, " ticks per frame via the framebuffer mapping (large pages ",
+        paging_large_pages_enabled() ? "on" : "off", "), ", small_ticks, " ticks per frame via 4KiB pages");
+}
+
 /*
  * (x,y) origin of the total extents
  * (w,h) size of the total extents
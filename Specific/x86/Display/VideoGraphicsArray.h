@@ -89,6 +89,7 @@ public:
     void copy_region(const u32* src, size_t x, size_t y, size_t w, size_t h) const;
     void drawSplash() const;
     void drawRegion(const u32* buffer_to_draw) const;
+    void benchmarkBlit(size_t n_frames) const;
     progress_bar_t createProgressBar(u32 x, u32 y, u32 w, u32 h, u32 border_width, u32 n_chunks);
     void setProgressBarPercent(progress_bar_t& bar, float percent);
     void setProgressBarChunk(progress_bar_t& bar, u32 chunk);
@@ -41,6 +41,7 @@ BusMasterController::BusMasterController(u16 new_base_port, IDE_drive_info_t* dr
         base_port = new_base_port;
     }
 
+    controller_id = drive->controller_id;
     LOG("Initialising busmaster device.");
     BM_status_t status = get_status();
     status.error = 1;
@@ -85,3 +86,38 @@ BM_status_t BusMasterController::get_status() const
     status.raw = inb(base_port + STATUS_OFFSET);
     return status;
 }
+
+/* The next transfer goes into physical_region. */
+void BusMasterController::target_physical_region() const
+{
+    DMA_PRDT_target_region(controller_id);
+}
+
+/**
+ * The next transfer goes straight into a kernel mapped buffer, scattered over whatever frames are behind it.
+ * @return number of bytes from the start of buffer which the table covers, which may be less than n_bytes
+ */
+size_t BusMasterController::target_buffer(char* buffer, const size_t n_bytes) const
+{
+    target_clear();
+    const size_t covered = target_append(buffer, n_bytes);
+    target_finish();
+    return covered;
+}
+
+/* Start describing a transfer scattered over several kernel mapped buffers, filled in the order they are appended. */
+void BusMasterController::target_clear() const
+{
+    DMA_PRDT_reset(controller_id);
+}
+
+/** @return number of bytes from the start of buffer which fitted in the table */
+size_t BusMasterController::target_append(char* buffer, const size_t n_bytes) const
+{
+    return DMA_PRDT_append_virtual(controller_id, buffer, n_bytes);
+}
+
+void BusMasterController::target_finish() const
+{
+    DMA_PRDT_finish(controller_id);
+}
@@ -35,8 +35,14 @@ public:
     BM_status_t set_status(BM_status_t status) const;
     BM_cmd_t get_cmd() const;
     BM_cmd_t set_cmd(BM_cmd_t cmd) const;
+    void target_physical_region() const;
+    size_t target_buffer(char* buffer, size_t n_bytes) const;
+    void target_clear() const;
+    size_t target_append(char* buffer, size_t n_bytes) const;
+    void target_finish() const;
     u8* physical_region;
     u16 base_port;
+    bool controller_id;
 
 };
 
@@ -20,6 +20,7 @@
 
 #include "IDEStorageContainer.h"
 
+#include <BlockCache.h>
 #include <paging.h>
 #include <PagingTableKernel.h>
 
@@ -40,6 +41,14 @@
 #include "cmp_int.h"
 
 constexpr i64 region_size = 65536;
+constexpr size_t max_sectors_per_read = 0xFFFF; // READ(10) transfer length
+constexpr size_t max_fill_extents = 16; // extents filled by one transfer into the block cache
+constexpr size_t readahead_extents = 8; // how far past a streaming read to prefetch
+constexpr u32 readahead_after = 2; // reads in a row which must follow on from each other before prefetching
+// Block aligned misses at least this big skip the cache and go straight into the destination, see target_bypass.
+constexpr size_t cache_bypass_bytes = readahead_extents * BlockCache::extent_bytes;
+// Even with every page of every extent in a different frame the table can describe a whole fill.
+static_assert(max_fill_extents * (BlockCache::extent_bytes / page_alignment + 1) <= PRDT_MAX_ENTRIES);
 #define one_sector_size this->drive_dev->get_drive_info()->sector_size
 #define one_block_size this->drive_dev->get_drive_info()->block_size
 
@@ -50,6 +59,7 @@ IDEStorageContainer::IDEStorageContainer(IDE_drive_info_t &drive_info, PCIDevice
     LOG("Initializing IDEStorageContainer");
     IDE_add_device(this);
     dma_context.busy = false;
+    cache_device = block_cache().add_device();
     this->pci_dev = pci_dev;
     this->bm_dev = bm_dev;
     if (drive_info.packet_device) {
@@ -89,25 +99,68 @@ int IDEStorageContainer::mount() {
     return populate_file_tree();
 }
 
-// Read from byte offset. Useful for use with files.
+// Read from byte offset. Useful for use with files. Queued requests wait until it is done.
 i64 IDEStorageContainer::read(char *dest, const size_t byte_offset, const size_t n_bytes) {
     busy = true;
+    finish_transfer();
+    const i64 res = block_cache().enabled()
+                        ? read_cached(dest, byte_offset, n_bytes)
+                        : read_uncached(dest, byte_offset, n_bytes);
+    busy = false;
+    start_next_transfer();
+    return res;
+}
+
+i64 IDEStorageContainer::read_cached(char *dest, const size_t byte_offset, const size_t n_bytes) {
+    if (n_bytes == 0) return 0;
+    const size_t last_extent = (byte_offset + n_bytes - 1) / BlockCache::extent_bytes;
+    block_cache().account(cache_device, byte_offset / BlockCache::extent_bytes, last_extent);
+    size_t n_read = copy_from_cache(dest, byte_offset, n_bytes);
+    while (n_read < n_bytes) {
+        const size_t position = byte_offset + n_read;
+        if (const size_t n_sectors = target_bypass(&dest[n_read], position, n_bytes - n_read); n_sectors > 0) {
+            if (const int res = read_direct_from_lba(position / one_block_size, n_sectors); res < 0) { return res; }
+            n_read += n_sectors * one_block_size;
+        } else if (const int res = read_into_cache(position / BlockCache::extent_bytes, last_extent); res < 0) {
+            return res;
+        }
+        n_read += copy_from_cache(&dest[n_read], byte_offset + n_read, n_bytes - n_read);
+    }
+    note_read(byte_offset, n_bytes);
+    return static_cast<i64>(n_read);
+}
+
+// Without the block cache: whole blocks go straight into dest and the rest through the bounce region.
+i64 IDEStorageContainer::read_uncached(char *dest, const size_t byte_offset, const size_t n_bytes) {
     // LOG("Reading from IDEStorageContainer::read(char*...). start: ", byte_offset, " length: ", n_bytes);
     i64 n_read = 0;
     // has to be able to be neg but also up to U32_MAX so use an i64. n_read >0 here due to program flow.
     i64 real_offset = byte_offset; // position within disk in bytes
     while (n_read < n_bytes) {
+        const bool in_region = real_offset < (stored_buffer_start + stored_buffer_size) &&
+                               real_offset >= stored_buffer_start && stored_buffer_start >= 0;
+        // Whole blocks which are not already in the region go straight into dest, in as few transfers as possible.
+        if (!in_region && real_offset % one_block_size == 0) {
+            if (const size_t n_sectors = target_direct(&dest[n_read], n_bytes - n_read); n_sectors > 0) {
+                if (const int res = read_direct_from_lba(real_offset / one_block_size, n_sectors); res < 0) {
+                    return res;
+                }
+                n_read += n_sectors * one_block_size;
+                real_offset = byte_offset + n_read;
+                continue;
+            }
+        }
         // Only load new physical region if necessary
-        if (real_offset >= (stored_buffer_start + region_size) || real_offset < stored_buffer_start ||
-            stored_buffer_start < 0) {
+        if (!in_region) {
             // rounds down. First sector containing missing data.
-            const size_t start_lba = static_cast<u16>((real_offset) / static_cast<i64>(one_block_size));
-            if (const int res = read_into_region_from_lba(start_lba); res < 0) { return res; }
+            const size_t start_lba = real_offset / static_cast<i64>(one_block_size);
+            if (const int res = read_into_region_from_lba(start_lba, bounce_sectors(real_offset, n_bytes - n_read));
+                res < 0) { return res; }
         }
 
         const size_t offset_in_store = real_offset - stored_buffer_start;
         // should calculate the offset from physical region start.
-        const i64 available_bytes = MIN(n_bytes - n_read, region_size - offset_in_store);
+        const i64 available_bytes = MIN(n_bytes - n_read, stored_buffer_size - offset_in_store);
         // either all remaining bytes or from first byte to end of region
         art_string::memcpy(&dest[n_read], &bm_dev->physical_region[offset_in_store],
                            static_cast<size_t>(available_bytes));
@@ -115,123 +168,389 @@ i64 IDEStorageContainer::read(char *dest, const size_t byte_offset, const size_t
         real_offset = byte_offset + n_read;
     }
     // LOG("nread: ", n_read);
-    busy = false;
     return n_read;
 }
 
+// The transfer in flight has finished. Called by notify or by finish_transfer.
 void IDEStorageContainer::async_notify() {
-    busy = true;
-    size_t offset_in_store;
-    i64 available_bytes;
-    BM_status_t bm_status = bm_dev->get_status();
+    if (!dma_context.busy) return; // already handled
+    const BM_status_t bm_status = bm_dev->get_status();
     if (bm_status.IDE_active || BM_waiting_for_transfer) {
 #if ENABLE_SERIAL_LOGGING
         get_serial().log("Notified but IDE still active?");
 #endif
         return;
     }
-    if (bm_status.error) {
+    const bool ok = !bm_status.error;
 #if ENABLE_SERIAL_LOGGING
-        get_serial().log("DMA error D: ");
+    if (!ok) get_serial().log("DMA error D: ");
 #endif
-        goto done;
-    }
 
     stop_DMA_read(); // should just reset BM start_stop
-    stored_buffer_start = dma_context.lba_offset * one_sector_size;
-    offset_in_store = dma_context.byte_offset - stored_buffer_start;
-    // should calculate the offset from physical region start.
-
-    available_bytes = MIN(dma_context.total_size - dma_context.bytes_read, region_size - offset_in_store);
-
-    // either all remaining bytes or from first byte to end of region
-    art_string::memcpy(&dma_context.user_buffer[dma_context.bytes_read], &bm_dev->physical_region[offset_in_store],
-                       static_cast<size_t>(available_bytes));
-    dma_context.bytes_read += available_bytes;
-    dma_context.byte_offset += available_bytes;
-
-    // start another read if necessary
-
-    if (dma_context.bytes_read < dma_context.total_size) {
+    dma_context.busy = false;
+    if (dma_context.cache_extents > 0) end_cache_fill(ok); // copied out by start_next_transfer
+    if (io_request_t* request = current_request; request != nullptr) {
+        if (!ok) {
+            current_request = nullptr;
+            finish_request(request, -DEVICE_ERROR);
+        } else if (dma_context.direct_bytes > 0) {
+            request->bytes_done += dma_context.direct_bytes; // already in place
+        } else if (dma_context.bounce_sectors > 0) {
+            stored_buffer_start = dma_context.lba_offset * one_sector_size;
+            stored_buffer_size = dma_context.bounce_sectors * one_sector_size;
+            const size_t offset_in_store = request->byte_offset + request->bytes_done - stored_buffer_start;
+            // either all remaining bytes or from first byte to end of region
+            const size_t available_bytes = MIN(request->n_bytes - request->bytes_done,
+                                               static_cast<size_t>(stored_buffer_size) - offset_in_store);
+            art_string::memcpy(&request->dest[request->bytes_done], &bm_dev->physical_region[offset_in_store],
+                               available_bytes);
+            request->bytes_done += available_bytes;
+        }
 #if ENABLE_SERIAL_LOGGING and DMA_LOGS
-        get_serial().log("DMA read finished but need more data: ", dma_context.bytes_read, " of ",
-                         dma_context.total_size, " bytes. Available this time: ", available_bytes);
+        get_serial().log("DMA read finished: ", request->bytes_done, " of ", request->n_bytes, " bytes");
 #endif
-        const size_t start_lba = ((dma_context.byte_offset) / static_cast<i64>(one_block_size)) & 0xffff;
-        dma_context.lba_offset = start_lba;
-        constexpr u16 n_sectors = 32;
-        prep_DMA_read(start_lba, n_sectors); // should set up ATA stuff and then set up BM stuff
-        start_DMA_transfer(); // should just set BM start_stop
-        busy = false;
-        return;
     }
+    if (block_cache().enabled()) serve_cached_requests();
+    start_next_transfer();
+}
+
+/**
+ * Queue an asynchronous read. Whatever is already in memory is copied straight away, which may complete the request
+ * before this returns. The rest is read in elevator order along with the other queued requests.
+ */
+int IDEStorageContainer::submit_read(io_request_t* request) {
+    request->bytes_done = 0;
+    request->next = nullptr;
+    if (request->n_bytes == 0) {
+        finish_request(request, 0);
+        return 0;
+    }
+    const size_t byte_offset = request->byte_offset;
+    if (block_cache().enabled()) {
+        block_cache().account(cache_device, byte_offset / BlockCache::extent_bytes,
+                              (byte_offset + request->n_bytes - 1) / BlockCache::extent_bytes);
+        request->bytes_done = copy_from_cache(request->dest, byte_offset, request->n_bytes);
+    } else if (!dma_context.busy && stored_buffer_start >= 0 && static_cast<i64>(byte_offset) >= stored_buffer_start &&
+               static_cast<i64>(byte_offset) < stored_buffer_start + stored_buffer_size) {
+        const size_t offset_in_store = byte_offset - stored_buffer_start;
+        request->bytes_done = MIN(request->n_bytes, static_cast<size_t>(stored_buffer_size) - offset_in_store);
+        art_string::memcpy(request->dest, &bm_dev->physical_region[offset_in_store], request->bytes_done);
+    }
+    if (request->bytes_done == request->n_bytes) {
+        finish_request(request, static_cast<i64>(request->n_bytes));
+        start_next_transfer(); // a reader streaming through prefetched extents keeps the readahead going
+        return 0;
+    }
+
 #if ENABLE_SERIAL_LOGGING and DMA_LOGS
-    get_serial().log("DMA read finished: ", dma_context.bytes_read, " of ", dma_context.total_size, " bytes");
+    get_serial().log("async reading ", request->n_bytes, " from ", byte_offset, ". already read: ", request->bytes_done);
 #endif
-done:
+    queue_request(request);
+    start_next_transfer();
+    return 0;
+}
 
-    const size_t offset_in_page = (reinterpret_cast<uintptr_t>(dma_context.user_buffer) % page_alignment);
-    kernel_pages().unmap_user_to_kernel(reinterpret_cast<uintptr_t>(dma_context.user_buffer),
-                                        dma_context.total_size + offset_in_page);
-    busy = false;
-    dma_context.busy = false;
+/* Insert in ascending byte_offset so that next_request can sweep across the disk. */
+void IDEStorageContainer::queue_request(io_request_t* request) {
+    io_request_t** link = &queued_requests;
+    while (*link != nullptr && (*link)->byte_offset <= request->byte_offset) link = &(*link)->next;
+    request->next = *link;
+    *link = request;
 }
 
-i64 IDEStorageContainer::async_read(char *dest, size_t byte_offset, size_t n_bytes) {
-    //  if in store, just write now, and return n_read >0
-    // else return n_read = 0 after starting the read.
-    busy = true;
-    i64 n_read = 0;
-    if (byte_offset < (stored_buffer_start + region_size) && byte_offset > stored_buffer_start &&
-        stored_buffer_start > 0) {
-        const i64 offset_in_store = byte_offset - stored_buffer_start;
-        // should calculate the offset from physical region start.
-        const i64 available_bytes = MIN(n_bytes - n_read, (region_size - offset_in_store));
-        // either all remaining bytes or from first byte to end of region
-        art_string::memcpy(&dest[n_read], &bm_dev->physical_region[offset_in_store],
-                           static_cast<size_t>(available_bytes));
-        n_read += available_bytes;
-        byte_offset += n_read;
-        if (n_read == n_bytes) {
-            busy = false;
-            return n_read;
-        };
+/**
+ * Take the first queued request at or after the last transfer, wrapping round to the lowest offset (C-LOOK). Requests
+ * from several processes are then served in one pass across the disk instead of seeking back and forth between them.
+ */
+io_request_t* IDEStorageContainer::next_request() {
+    io_request_t** link = &queued_requests;
+    while (*link != nullptr && (*link)->byte_offset < elevator_position) link = &(*link)->next;
+    if (*link == nullptr) link = &queued_requests;
+    io_request_t* request = *link;
+    if (request != nullptr) {
+        *link = request->next;
+        request->next = nullptr;
     }
+    return request;
+}
 
-    constexpr u16 n_sectors = 32;
-    const size_t start_lba = ((byte_offset) / static_cast<i64>(one_block_size)) & 0xFFFF;
+void IDEStorageContainer::finish_request(io_request_t* request, const i64 result) {
+    if (result >= 0) note_read(request->byte_offset, request->n_bytes);
+    request->result = result;
+    request->on_complete(request);
+}
 
-    dma_context.bytes_read = n_read;
-    dma_context.busy = true;
-    dma_context.byte_offset = byte_offset;
-    dma_context.total_size = n_bytes;
-    dma_context.user_buffer = dest;
-    dma_context.lba_offset = start_lba;
+/* Complete queued requests whose data the last fill brought into the cache, so that overlapping reads share it. */
+void IDEStorageContainer::serve_cached_requests() {
+    io_request_t** link = &queued_requests;
+    while (*link != nullptr) {
+        io_request_t* request = *link;
+        request->bytes_done += copy_from_cache(&request->dest[request->bytes_done],
+                                               request->byte_offset + request->bytes_done,
+                                               request->n_bytes - request->bytes_done);
+        if (request->bytes_done < request->n_bytes) {
+            link = &request->next;
+            continue;
+        }
+        *link = request->next;
+        request->next = nullptr;
+        finish_request(request, static_cast<i64>(request->n_bytes));
+    }
+}
 
-#if ENABLE_SERIAL_LOGGING and DMA_LOGS
-    get_serial().log("async reading ", n_bytes, " from ", byte_offset, " i.e. LBA: ", start_lba, ". already read: ",
-                     n_read);
-#endif
+/**
+ * Keep the device busy: finish the current request once it has all of its data or start its next transfer, then move
+ * on to the next queued request. With nothing queued a readahead may start instead. Does nothing while a transfer is
+ * in flight or a synchronous read has the device.
+ */
+void IDEStorageContainer::start_next_transfer() {
+    if (busy || dma_context.busy) return;
+    if (current_request == nullptr) current_request = next_request();
+    while (current_request != nullptr) {
+        io_request_t* request = current_request;
+        if (block_cache().enabled()) {
+            request->bytes_done += copy_from_cache(&request->dest[request->bytes_done],
+                                                   request->byte_offset + request->bytes_done,
+                                                   request->n_bytes - request->bytes_done);
+        }
+        if (request->bytes_done < request->n_bytes && start_async_transfer() == 0) return;
+        current_request = next_request();
+        finish_request(request, request->bytes_done == request->n_bytes
+                                    ? static_cast<i64>(request->n_bytes)
+                                    : -DEVICE_ERROR);
+    }
+    if (readahead_wanted) {
+        readahead_wanted = false;
+        start_readahead();
+    }
+}
 
-    // put data in physical region
-    int ret_val = 0;
-    ret_val = prep_DMA_read(start_lba, n_sectors); // should set up ATA stuff and then set up BM stuff
-    if (ret_val != 0) { return -1; }
+/**
+ * Start the next DMA of current_request. With the block cache this fills the next uncached extents, which
+ * start_next_transfer copies out. Otherwise whole blocks go straight into the request's buffer and anything else fills
+ * the bounce region.
+ */
+int IDEStorageContainer::start_async_transfer() {
+    io_request_t* request = current_request;
+    const size_t position = request->byte_offset + request->bytes_done;
+    const size_t remaining = request->n_bytes - request->bytes_done;
+    size_t start_lba = position / one_block_size;
+    dma_context.direct_bytes = 0;
+    dma_context.bounce_sectors = 0;
+    dma_context.cache_extents = 0;
+    dma_context.readahead = false;
+    size_t n_sectors = 0;
+    if (block_cache().enabled()) {
+        n_sectors = target_bypass(&request->dest[request->bytes_done], position, remaining);
+        dma_context.direct_bytes = n_sectors * one_block_size;
+        if (n_sectors == 0) {
+            const size_t first_extent = position / BlockCache::extent_bytes;
+            const size_t last_extent = (position + remaining - 1) / BlockCache::extent_bytes;
+            n_sectors = target_cache_fill(first_extent, uncached_run(first_extent, last_extent), false);
+            if (n_sectors == 0) return -1;
+            start_lba = first_extent * (BlockCache::extent_bytes / one_block_size);
+        }
+    } else if (position % one_block_size == 0) {
+        n_sectors = target_direct(&request->dest[request->bytes_done], remaining);
+        dma_context.direct_bytes = n_sectors * one_block_size;
+    }
+    if (n_sectors == 0) {
+        bm_dev->target_physical_region();
+        n_sectors = bounce_sectors(position, remaining);
+        dma_context.bounce_sectors = n_sectors;
+    }
+    dma_context.lba_offset = start_lba;
+    // should set up ATA stuff and then set up BM stuff
+    if (prep_DMA_read(start_lba, n_sectors) != 0) {
+        end_cache_fill(false);
+        return -1;
+    }
+    elevator_position = position;
+    dma_context.busy = true;
     start_DMA_transfer(); // should just set BM start_stop
-    busy = false;
     return 0;
 }
 
-bool IDEStorageContainer::device_busy()
-{
-    return busy || dma_context.busy;
+/**
+ * Blocks to read into the bounce region for a request starting part way through a block or shorter than one. Only the
+ * partial first block is bounced if whole blocks follow, since those go straight to the destination. Otherwise the
+ * whole region is filled so that small sequential reads find the following data already there.
+ */
+size_t IDEStorageContainer::bounce_sectors(const size_t byte_offset, const size_t n_bytes) {
+    const size_t to_boundary = one_block_size - byte_offset % one_block_size;
+    if (to_boundary != one_block_size && n_bytes >= to_boundary + one_block_size) return 1;
+    return region_size / one_block_size;
 }
 
-i64 IDEStorageContainer::async_n_read() {
-#if ENABLE_SERIAL_LOGGING and DMA_LOGS
-    get_serial().log("async_n_read called: ", dma_context.bytes_read);
-#endif
-    return dma_context.bytes_read;
+/**
+ * Point the bus master at as many whole blocks of dest as one transfer can take.
+ * @return number of blocks, 0 if there is not a whole block or dest is not word aligned
+ */
+size_t IDEStorageContainer::target_direct(char* dest, const size_t n_bytes) {
+    if (reinterpret_cast<uintptr_t>(dest) & 1) return 0;
+    size_t n_sectors = MIN(n_bytes / one_block_size, max_sectors_per_read);
+    if (n_sectors == 0) return 0;
+    const size_t covered = bm_dev->target_buffer(dest, n_sectors * one_block_size);
+    // The table must describe exactly the transfer, otherwise the bus master never reports it finished.
+    if (covered != n_sectors * one_block_size) {
+        n_sectors = covered / one_block_size;
+        if (n_sectors == 0) return 0;
+        bm_dev->target_buffer(dest, n_sectors * one_block_size);
+    }
+    return n_sectors;
+}
+
+/**
+ * Point the bus master straight at dest for a large block aligned miss, as far as the next cached extent, so that big
+ * reads keep the zero-copy path of read_uncached. Small and unaligned reads, and prefetch, go through the cache.
+ * @return number of blocks, 0 if the read should be filled through the cache instead
+ */
+size_t IDEStorageContainer::target_bypass(char* dest, const size_t byte_offset, const size_t n_bytes) {
+    if (byte_offset % one_block_size != 0 || n_bytes < cache_bypass_bytes) return 0;
+    const size_t max_bytes = MIN(n_bytes, max_sectors_per_read * one_block_size);
+    size_t uncached = 0;
+    while (uncached < max_bytes &&
+           !block_cache().contains(cache_device, (byte_offset + uncached) / BlockCache::extent_bytes)) {
+        uncached += BlockCache::extent_bytes - (byte_offset + uncached) % BlockCache::extent_bytes;
+    }
+    return target_direct(dest, MIN(uncached, max_bytes));
+}
+
+/* Size of the medium in bytes, or 0 if the drive did not report it. */
+u64 IDEStorageContainer::disk_bytes() {
+    const u64 last_lba = get_block_count();
+    return last_lba == 0 ? 0 : (last_lba + 1) * one_block_size;
+}
+
+/**
+ * Copy the cached part of a read into dest, from byte_offset up to the first extent which is not cached.
+ * @return number of bytes copied
+ */
+size_t IDEStorageContainer::copy_from_cache(char* dest, const size_t byte_offset, const size_t n_bytes) {
+    size_t n_copied = 0;
+    while (n_copied < n_bytes) {
+        const size_t offset = byte_offset + n_copied;
+        const char* extent = block_cache().lookup(cache_device, offset / BlockCache::extent_bytes);
+        if (extent == nullptr) break;
+        const size_t offset_in_extent = offset % BlockCache::extent_bytes;
+        const size_t n = MIN(n_bytes - n_copied, BlockCache::extent_bytes - offset_in_extent);
+        art_string::memcpy(&dest[n_copied], &extent[offset_in_extent], n);
+        n_copied += n;
+    }
+    return n_copied;
+}
+
+/* Number of extents from first_extent up to last_extent which are not cached, as many as one fill can take. */
+size_t IDEStorageContainer::uncached_run(const size_t first_extent, const size_t last_extent) {
+    // Extents being filled cannot be evicted, so leave room for the other devices sharing the cache
+    const size_t max_extents = MIN(max_fill_extents, MAX(block_cache().capacity() / 2, size_t{1}));
+    const u64 end = disk_bytes();
+    size_t n = 0;
+    while (n < max_extents && first_extent + n <= last_extent &&
+           (end == 0 || static_cast<u64>(first_extent + n) * BlockCache::extent_bytes < end) &&
+           !block_cache().contains(cache_device, first_extent + n)) {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Reserve cache extents and point the bus master at them. The last extent of the medium is only filled as far as
+ * the medium goes.
+ * @return number of blocks to read into them, 0 if there is nothing to fill
+ */
+size_t IDEStorageContainer::target_cache_fill(const size_t first_extent, const size_t n_extents, const bool readahead) {
+    if (n_extents == 0) return 0;
+    const u64 end = disk_bytes();
+    size_t n_bytes = 0;
+    bm_dev->target_clear();
+    for (size_t i = 0; i < n_extents; i++) {
+        const u64 start = static_cast<u64>(first_extent + i) * BlockCache::extent_bytes;
+        const size_t fill_bytes = end == 0 ? BlockCache::extent_bytes : MIN(end - start, u64{BlockCache::extent_bytes});
+        char* slot = block_cache().reserve(cache_device, first_extent + i);
+        if (slot == nullptr || bm_dev->target_append(slot, fill_bytes) != fill_bytes) {
+            // only what this fill reserved, a slot which could not be reserved may be another fill's
+            for (size_t j = 0; j < i + (slot != nullptr); j++) block_cache().drop(cache_device, first_extent + j);
+            return 0;
+        }
+        n_bytes += fill_bytes;
+    }
+    bm_dev->target_finish();
+    dma_context.cache_extent = first_extent;
+    dma_context.cache_extents = n_extents;
+    dma_context.readahead = readahead;
+    block_cache().count_fill();
+    return n_bytes / one_block_size;
+}
+
+/* Publish the extents the finished transfer filled, or forget them if it failed. */
+void IDEStorageContainer::end_cache_fill(const bool ok) {
+    for (size_t i = 0; i < dma_context.cache_extents; i++) {
+        if (ok) {
+            block_cache().commit(cache_device, dma_context.cache_extent + i, dma_context.readahead);
+        } else {
+            block_cache().drop(cache_device, dma_context.cache_extent + i);
+        }
+    }
+    dma_context.cache_extents = 0;
+}
+
+// Synchronously fill the uncached extents from first_extent, which is not cached, towards last_extent.
+int IDEStorageContainer::read_into_cache(const size_t first_extent, const size_t last_extent) {
+    const size_t n_sectors = target_cache_fill(first_extent, uncached_run(first_extent, last_extent), false);
+    if (n_sectors == 0) return -DEVICE_ERROR; // past the end of the medium
+    const int res = read_direct_from_lba(first_extent * (BlockCache::extent_bytes / one_block_size), n_sectors);
+    end_cache_fill(res == 0);
+    return res;
+}
+
+/* A synchronous read cannot rely on the completion interrupt, which may be masked, so it polls the transfer in flight
+ * to the end. busy stops async_notify from starting the next one. */
+void IDEStorageContainer::finish_transfer() {
+    if (!dma_context.busy) return;
+    BM_status_t bm_status = bm_dev->get_status();
+    while (bm_status.IDE_active && !bm_status.error) {
+        bm_status = bm_dev->get_status();
+    }
+    bm_status.interrupt = true; // writing 1 clears the bit so the late interrupt is not taken for the next transfer
+    bm_dev->set_status(bm_status);
+    BM_waiting_for_transfer = false;
+    async_notify();
+}
+
+/**
+ * Called when a read completes. Once reads keep starting where the last one ended, the extents which follow are
+ * prefetched into the cache while the reader works on what it has.
+ */
+void IDEStorageContainer::note_read(const size_t byte_offset, const size_t n_bytes) {
+    sequential_reads = byte_offset == next_sequential_offset ? sequential_reads + 1 : 0;
+    next_sequential_offset = byte_offset + n_bytes;
+    readahead_wanted = block_cache().enabled() && sequential_reads >= readahead_after;
+}
+
+void IDEStorageContainer::start_readahead() {
+    const size_t next_extent = next_sequential_offset / BlockCache::extent_bytes;
+    const size_t last_extent = next_extent + readahead_extents - 1;
+    size_t first_extent = next_extent;
+    while (first_extent <= last_extent && block_cache().contains(cache_device, first_extent)) first_extent++;
+    if (first_extent > last_extent) return;
+    const size_t n_sectors = target_cache_fill(first_extent, uncached_run(first_extent, last_extent), true);
+    if (n_sectors == 0) return;
+    dma_context.direct_bytes = 0;
+    dma_context.bounce_sectors = 0;
+    dma_context.lba_offset = first_extent * (BlockCache::extent_bytes / one_block_size);
+    if (prep_DMA_read(dma_context.lba_offset, n_sectors) != 0) {
+        end_cache_fill(false);
+        return;
+    }
+    dma_context.busy = true;
+    start_DMA_transfer();
+}
+
+// Queued requests do not count: a synchronous read finishes the transfer in flight itself.
+bool IDEStorageContainer::device_busy()
+{
+    return busy;
 }
 
 i64 IDEStorageContainer::read(void *dest, const size_t byte_offset, const size_t n_bytes) {
@@ -306,13 +625,10 @@ int IDEStorageContainer::stop_DMA_read() {
 }
 
 
-int IDEStorageContainer::read_into_region_from_lba(size_t lba_offset) {
-    // TODO: This should always be called to read 64K at a time.
-
-    // trim oversize reads
-    constexpr u16 n_sectors = 32;
+int IDEStorageContainer::read_into_region_from_lba(const size_t lba_offset, const size_t n_sectors) {
 
     // put data in physical region
+    bm_dev->target_physical_region();
     int ret_val = 0;
     ret_val = prep_DMA_read(lba_offset, n_sectors); // should set up ATA stuff and then set up BM stuff
     if (ret_val != 0) { return ret_val; }
@@ -328,6 +644,18 @@ int IDEStorageContainer::read_into_region_from_lba(size_t lba_offset) {
         return ret_val;
     }
     stored_buffer_start = lba_offset * one_sector_size;
+    stored_buffer_size = n_sectors * one_sector_size;
+    return ret_val;
+}
+
+// Synchronous read of whole blocks straight into whatever the bus master was last pointed at.
+int IDEStorageContainer::read_direct_from_lba(const size_t lba_offset, const size_t n_sectors) {
+    int ret_val = prep_DMA_read(lba_offset, n_sectors);
+    if (ret_val != 0) { return ret_val; }
+    start_DMA_transfer();
+    ret_val = wait_for_DMA_transfer();
+    // TODO: as read_into_region_from_lba, errors from the wait are not reliable at full speed.
+    ret_val = stop_DMA_read();
     return ret_val;
 }
 
@@ -22,6 +22,7 @@
 
 #include <paging.h>
 
+#include "cmp_int.h"
 #include "logging.h"
 #include "ports.h"
 #include "stdlib.h"
@@ -34,34 +35,44 @@
 
 #define PRDT_SIZE 65536
 
-u8 IDE_DMA_primary_physical_region[PRDT_SIZE] __attribute__((aligned(1024 * 64))) = {};
+// Physical regions are allocated when the controller is initialised. A 64KiB buddy block is 64KiB aligned so never
+// crosses the 64KiB boundary a PRD may not cross.
+u8* IDE_DMA_primary_physical_region = nullptr;
+uintptr_t IDE_DMA_primary_region_phys = 0;
 PRDT_t IDE_DMA_primary_prd_table{};
+size_t IDE_DMA_primary_prd_count = 0;
 
-u8 IDE_DMA_secondary_physical_region[PRDT_SIZE] __attribute__((aligned(1024 * 64))) = {};
+u8* IDE_DMA_secondary_physical_region = nullptr;
+uintptr_t IDE_DMA_secondary_region_phys = 0;
 PRDT_t IDE_DMA_secondary_prd_table{};
+size_t IDE_DMA_secondary_prd_count = 0;
 
 
 //  https://forum.osdev.org/viewtopic.php?t=19056
 u8* DMA_init_PRDT(const bool controller_id, const u16 base_port)
 {
-    u32 table_loc = 0;
-    if (controller_id)
+    u8*& region = controller_id ? IDE_DMA_secondary_physical_region : IDE_DMA_primary_physical_region;
+    uintptr_t region_phys = 0;
+    if (region == nullptr)
     {
-        IDE_DMA_secondary_prd_table.descriptor.base_addr = kget_mapping_target(&IDE_DMA_secondary_physical_region) & 0xFFFFFFFE; // last bit reserved
-        IDE_DMA_secondary_prd_table.descriptor.length_in_b = 0;
-        IDE_DMA_secondary_prd_table.descriptor.end_of_table = 1;
-
-        table_loc = kget_mapping_target(&IDE_DMA_secondary_prd_table.descriptor) & 0xFFFFFFFC; // last 2 bits reserved
+        region = static_cast<u8*>(kmmap_contiguous(PRDT_SIZE, &region_phys));
+        if (region == nullptr)
+        {
+            LOG("Error allocating DMA physical region");
+            return nullptr;
+        }
     }
     else
     {
-        IDE_DMA_primary_prd_table.descriptor.base_addr = kget_mapping_target(&IDE_DMA_primary_physical_region) & 0xFFFFFFFE; // last bit reserved
-        IDE_DMA_primary_prd_table.descriptor.length_in_b = 0;
-        IDE_DMA_primary_prd_table.descriptor.end_of_table = 1;
-
-        table_loc = kget_mapping_target(&IDE_DMA_primary_prd_table.descriptor) & 0xFFFFFFFC; // last 2 bits reserved
+        region_phys = kget_mapping_target(region);
     }
 
+    (controller_id ? IDE_DMA_secondary_region_phys : IDE_DMA_primary_region_phys) = region_phys;
+    DMA_PRDT_target_region(controller_id);
+
+    PRDT_t& table = controller_id ? IDE_DMA_secondary_prd_table : IDE_DMA_primary_prd_table;
+    const u32 table_loc = kget_mapping_target(&table) & 0xFFFFFFFC; // last 2 bits reserved
+
     outw(base_port + PRDT_START_OFFSET, table_loc & 0xFFFF); // low bytes
     outw(base_port + PRDT_START_OFFSET + 2, (table_loc >> 16) & 0xFFFF); // high bytes
 
@@ -70,11 +81,7 @@ u8* DMA_init_PRDT(const bool controller_id, const u16 base_port)
         LOG("Error setting physical region");
         return nullptr;
     }
-    if (controller_id)
-    {
-        return IDE_DMA_secondary_physical_region;
-    }
-    return IDE_DMA_primary_physical_region;
+    return region;
 }
 
 
@@ -84,3 +91,86 @@ void DMA_free_prdt()
 
     // free(IDE_DMA_primary_physical_region);
 }
+
+void DMA_PRDT_reset(const bool controller_id)
+{
+    (controller_id ? IDE_DMA_secondary_prd_count : IDE_DMA_primary_prd_count) = 0;
+}
+
+/**
+ * Add physically contiguous memory to the end of the table. It is split at 64KiB boundaries and merged into the
+ * previous entry where it carries straight on from it.
+ * @return false if the table is full or the memory is not word aligned
+ */
+bool DMA_PRDT_append(const bool controller_id, uintptr_t phys_addr, size_t n_bytes)
+{
+    if ((phys_addr | n_bytes) & 1) return false;
+    PRDT_t& table = controller_id ? IDE_DMA_secondary_prd_table : IDE_DMA_primary_prd_table;
+    size_t& count = controller_id ? IDE_DMA_secondary_prd_count : IDE_DMA_primary_prd_count;
+    while (n_bytes > 0)
+    {
+        const size_t offset_in_window = phys_addr & (PRD_MAX_BYTES - 1);
+        const size_t chunk = MIN(n_bytes, PRD_MAX_BYTES - offset_in_window);
+        if (count > 0 && offset_in_window != 0)
+        {
+            // Not at a boundary so the previous entry, if it ends here, is in the same window and can grow.
+            PRD_t& last = table.descriptors[count - 1];
+            if (const size_t last_len = last.length_in_b == 0 ? PRD_MAX_BYTES : last.length_in_b;
+                last.base_addr + last_len == phys_addr)
+            {
+                last.length_in_b = (last_len + chunk) & 0xFFFF; // 0 means 64KiB
+                phys_addr += chunk;
+                n_bytes -= chunk;
+                continue;
+            }
+        }
+        if (count >= PRDT_MAX_ENTRIES) return false;
+        PRD_t& prd = table.descriptors[count++];
+        prd.raw = 0;
+        prd.base_addr = phys_addr;
+        prd.length_in_b = chunk & 0xFFFF;
+        phys_addr += chunk;
+        n_bytes -= chunk;
+    }
+    return true;
+}
+
+/**
+ * Add the physical pages behind a kernel mapped buffer.
+ * @return number of bytes from v_addr which were added. Less than n_bytes if the table filled or a page is not mapped.
+ */
+size_t DMA_PRDT_append_virtual(const bool controller_id, void* v_addr, const size_t n_bytes)
+{
+    auto addr = reinterpret_cast<uintptr_t>(v_addr);
+    size_t added = 0;
+    while (added < n_bytes)
+    {
+        const size_t offset_in_page = addr % page_alignment;
+        const size_t chunk = MIN(n_bytes - added, page_alignment - offset_in_page);
+        const uintptr_t frame = kget_mapping_target(reinterpret_cast<void*>(addr));
+        // A chunk never crosses a page so it is either added whole or not at all.
+        if (frame == 0 || !DMA_PRDT_append(controller_id, frame + offset_in_page, chunk)) break;
+        added += chunk;
+        addr += chunk;
+    }
+    return added;
+}
+
+/** Mark the last entry as the end of the table. @return false if the table is empty */
+bool DMA_PRDT_finish(const bool controller_id)
+{
+    PRDT_t& table = controller_id ? IDE_DMA_secondary_prd_table : IDE_DMA_primary_prd_table;
+    const size_t count = controller_id ? IDE_DMA_secondary_prd_count : IDE_DMA_primary_prd_count;
+    if (count == 0) return false;
+    table.descriptors[count - 1].end_of_table = 1;
+    return true;
+}
+
+/* Point the table back at the whole bounce region. */
+void DMA_PRDT_target_region(const bool controller_id)
+{
+    DMA_PRDT_reset(controller_id);
+    DMA_PRDT_append(controller_id, controller_id ? IDE_DMA_secondary_region_phys : IDE_DMA_primary_region_phys,
+                    PRDT_SIZE);
+    DMA_PRDT_finish(controller_id);
+}
@@ -38,6 +38,9 @@
 #define MEM_TO_DEV 0x00
 #define DMA_MODE 0x08
 
+#define PRDT_MAX_ENTRIES 512 // one page of descriptors, at least 2MiB per transfer even if every page is scattered
+#define PRD_MAX_BYTES 65536 // a descriptor covers at most 64KiB and may not cross a 64KiB boundary
+
 
 // Physical Region Descriptor Table
 struct PRD_t
@@ -56,11 +59,11 @@ struct PRD_t
     };
 };
 
+// Exactly one page, so the table itself never crosses the 64KiB boundary it may not cross.
 struct PRDT_t
 {
-    PRD_t descriptor;
-
-}__attribute__((aligned(4)));
+    PRD_t descriptors[PRDT_MAX_ENTRIES];
+}__attribute__((aligned(4096)));
 
 
 struct BM_cmd_t
@@ -98,10 +101,15 @@ struct BM_status_t
     };
 };
 
-// TODO: create a PRD object and make it so that there can be 2 PRDTs (one for each DMA controller)
-// Have only made it possible to have one PRD for each device. Therefore End of Table is always 1.
+// One PRDT per controller. By default it holds a single entry for the 64KiB bounce region returned by DMA_init_PRDT
+// but a transfer can instead scatter straight into any buffer: DMA_PRDT_reset, append the regions, DMA_PRDT_finish.
 u8* DMA_init_PRDT(bool controller_id, u16 base_port);
 void DMA_free_prdt(u16 base_addr);
+void DMA_PRDT_reset(bool controller_id);
+bool DMA_PRDT_append(bool controller_id, uintptr_t phys_addr, size_t n_bytes);
+size_t DMA_PRDT_append_virtual(bool controller_id, void* v_addr, size_t n_bytes);
+bool DMA_PRDT_finish(bool controller_id);
+void DMA_PRDT_target_region(bool controller_id);
 
 
 #endif //IDE_H
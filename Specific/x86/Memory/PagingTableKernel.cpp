@@ -59,6 +59,7 @@ void PagingTableKernel::assign_page_table_entry(const uintptr_t physical_addr, c
     tab_entry.physical_address = physical_addr >> base_address_shift;
     tab_entry.rw = writable;
     tab_entry.user_access = user;
+    tab_entry.global = v_addr.page_directory_index >= kernel_first_dir_idx;
     boot_page_tables[v_addr.page_directory_index].table[v_addr.page_table_index] = tab_entry;
     page_available_virtual_bitmap.set_bit(v_addr.raw >> base_address_shift, false);
     set_physical_bitmap_addr(physical_addr, false);
@@ -67,28 +68,172 @@ void PagingTableKernel::assign_page_table_entry(const uintptr_t physical_addr, c
 
 int PagingTableKernel::unassign_page_table_entries(const size_t start_idx, const size_t n_pages) {
     // TODO: mark empty dicts as not present?
-    for (size_t i = start_idx; i < start_idx + n_pages; i++) {
+    size_t i = start_idx;
+    for (; i < start_idx + n_pages; i++) {
+        if (dir_is_large(i / page_table_len)) {
+            if (i % page_table_len == 0 && start_idx + n_pages - i >= large_page_n_pages) {
+                // whole 4MiB page goes back at once
+                page_free_phys_run(boot_page_directory[i / page_table_len].page_table_entry_address << base_address_shift,
+                                   large_page_n_pages);
+                boot_page_directory[i / page_table_len].raw = 0;
+                if (i / page_table_len >= kernel_first_dir_idx) {
+                    // kernel directory entries always point at their boot table
+                    assign_page_directory_entry(i / page_table_len, true, false);
+                    PagingTableUser::sync_kernel_dir_entry(i / page_table_len);
+                }
+                tlb_flush_range(i << base_address_shift, large_page_n_pages);
+                i += large_page_n_pages - 1;
+                continue;
+            }
+            split_large_page(i / page_table_len);
+        }
         auto *tab_entry = &boot_page_tables[i / 1024].table[i % 1024];
-        if (!tab_entry->present)return -1;
+        if (!tab_entry->present) break;
 
         const size_t phys_idx = tab_entry->physical_address;
 
         set_physical_bitmap_idx(phys_idx, true);
         tab_entry->raw = 0;
     }
-    page_available_virtual_bitmap.set_range(start_idx, n_pages, true);
+    if (i > start_idx) {
+        page_available_virtual_bitmap.set_range(start_idx, i, true);
+        tlb_flush_range(start_idx << base_address_shift, i - start_idx);
+    }
 
-    return 0;
+    return i == start_idx + n_pages ? 0 : -1;
+}
+
+/**
+ * Map a list of physical runs to consecutive virtual pages, filling each page table a span at a time.
+ * The physical frames must already be allocated.
+ * @param v_addr first virtual address, page aligned
+ * @param runs physical runs in virtual address order
+ * @param n_runs number of runs
+ * @param n_pages total pages to map, at most the sum of the run lengths
+ * @param flags PAGING_WRITABLE and/or PAGING_USER
+ */
+void PagingTableKernel::map_range(const uintptr_t v_addr, const phys_run_t *runs, const size_t n_runs,
+                                  const size_t n_pages, const int flags) {
+    const bool writable = flags & PAGING_WRITABLE;
+    const bool user = flags & PAGING_USER;
+    virtual_address_t working_addr = {v_addr};
+    size_t mapped = 0;
+    for (size_t r = 0; r < n_runs && mapped < n_pages; r++) {
+        size_t phys_idx = runs[r].phys_addr >> base_address_shift;
+        size_t remaining = MIN(runs[r].n_pages, n_pages - mapped);
+        while (remaining > 0) {
+            if (!dir_entry_present(working_addr.page_directory_index)) {
+                assign_page_directory_entry(working_addr.page_directory_index, writable, user);
+            } else if (dir_is_large(working_addr.page_directory_index)) {
+                split_large_page(working_addr.page_directory_index);
+            }
+            const size_t span = MIN(remaining, page_table_len - working_addr.page_table_index);
+            page_table_entry_t *entries = &boot_page_tables[working_addr.page_directory_index].table[
+                working_addr.page_table_index];
+            page_table_entry_t tab_entry{};
+            tab_entry.present = true;
+            tab_entry.rw = writable;
+            tab_entry.user_access = user;
+            tab_entry.global = working_addr.page_directory_index >= kernel_first_dir_idx;
+            for (size_t i = 0; i < span; i++) {
+                tab_entry.physical_address = phys_idx + i;
+                entries[i] = tab_entry;
+            }
+            phys_idx += span;
+            remaining -= span;
+            mapped += span;
+            working_addr.raw += span * page_alignment;
+        }
+    }
+    const size_t first_page = v_addr >> base_address_shift;
+    page_available_virtual_bitmap.set_range(first_page, first_page + mapped, false);
+    tlb_flush_range(v_addr, mapped);
+}
+
+/**
+ * Clear the mappings for a range of kernel pages without giving their frames back, e.g. for device memory.
+ */
+void PagingTableKernel::unmap_range(const uintptr_t v_addr, const size_t n_pages) {
+    const size_t first_page = v_addr >> base_address_shift;
+    for (size_t i = first_page; i < first_page + n_pages; i++) {
+        if (dir_is_large(i / page_table_len)) split_large_page(i / page_table_len);
+        boot_page_tables[i / page_table_len].table[i % page_table_len].raw = 0;
+    }
+    page_available_virtual_bitmap.set_range(first_page, first_page + n_pages, true);
+    tlb_flush_range(v_addr, n_pages);
+}
+
+bool PagingTableKernel::dir_is_large(const size_t dir_idx) {
+    return boot_page_directory[dir_idx].present && boot_page_directory[dir_idx].extended_page_size;
+}
+
+/** @return true if nothing is mapped through this directory entry yet, so it can hold a 4MiB page */
+bool PagingTableKernel::table_is_empty(const size_t dir_idx) {
+    if (!boot_page_directory[dir_idx].present) return true;
+    if (boot_page_directory[dir_idx].extended_page_size) return false;
+    for (const auto &entry: boot_page_tables[dir_idx].table) {
+        if (entry.present) return false;
+    }
+    return true;
+}
+
+/**
+ * Map a whole directory entry as one 4MiB page. Only valid once CR4.PSE is set.
+ * @param physical_addr 4MiB aligned physical address
+ * @param dir_idx directory entry, which must not have any 4KiB pages mapped
+ * @param flags PAGING_WRITABLE and/or PAGING_USER
+ */
+void PagingTableKernel::assign_large_page(const uintptr_t physical_addr, const size_t dir_idx, const int flags) {
+    page_directory_4kb_t dir_entry{};
+    dir_entry.present = true;
+    dir_entry.rw = flags & PAGING_WRITABLE;
+    dir_entry.user_access = flags & PAGING_USER;
+    dir_entry.extended_page_size = true;
+    dir_entry.page_table_entry_address = physical_addr >> base_address_shift;
+    if (dir_idx >= kernel_first_dir_idx) dir_entry.raw |= PAGE_DIR_LARGE_GLOBAL;
+    boot_page_directory[dir_idx] = dir_entry;
+    if (dir_idx >= kernel_first_dir_idx) PagingTableUser::sync_kernel_dir_entry(dir_idx);
+    page_available_virtual_bitmap.set_range(dir_idx * page_table_len, (dir_idx + 1) * page_table_len, false);
+    tlb_flush_range(dir_idx * large_page_size, large_page_n_pages);
+}
+
+/**
+ * Turn a 4MiB page back into a page table of 4KiB entries covering the same frames, so part of it can be changed.
+ */
+void PagingTableKernel::split_large_page(const size_t dir_idx) {
+    const page_directory_4kb_t large = boot_page_directory[dir_idx];
+    page_table_entry_t tab_entry{};
+    tab_entry.present = true;
+    tab_entry.rw = large.rw;
+    tab_entry.user_access = large.user_access;
+    tab_entry.global = dir_idx >= kernel_first_dir_idx;
+    for (size_t i = 0; i < page_table_len; i++) {
+        tab_entry.physical_address = large.page_table_entry_address + i;
+        boot_page_tables[dir_idx].table[i] = tab_entry;
+    }
+    assign_page_directory_entry(dir_idx, large.rw, large.user_access);
+    if (dir_idx >= kernel_first_dir_idx) PagingTableUser::sync_kernel_dir_entry(dir_idx);
+    tlb_flush_range(dir_idx * large_page_size, large_page_n_pages);
 }
 
+/**
+ * Map a buffer of the current process into the kernel half so a device or another address space can fill it. The
+ * pages are made present and private first and each frame is pinned with a share so that it survives the process
+ * unmapping it or exiting until unmap_user_to_kernel.
+ * @return kernel address of the page containing user_vaddr or 0 if the buffer is not mapped writable
+ */
 uintptr_t PagingTableKernel::map_user_to_kernel(const uintptr_t user_vaddr, const i64 length) {
     const size_t n_pages = (length + page_alignment - 1) >> base_address_shift;
     PagingTableUser &user_tables = Scheduler::get().getCurrentPagingTable();
+    // length counts from the start of the page, as callers add the offset of user_vaddr within it
+    if (!user_tables.prepare_write_target(user_vaddr & ~(page_alignment - 1), length)) return 0;
     const uintptr_t k_v_addr = get_next_virtual_chunk(0, n_pages);
+    if (k_v_addr == 0) return 0;
     uintptr_t working_user_v_addr = user_vaddr;
     uintptr_t working_k_v_addr = k_v_addr;
-    for (int i = 0; i < n_pages; i++) {
+    for (size_t i = 0; i < n_pages; i++) {
         const uintptr_t phys = user_tables.get_phys_from_virtual(working_user_v_addr);
+        page_frame_share(phys);
         direct_map(phys, working_k_v_addr, true, false);
         working_user_v_addr += page_alignment;
         working_k_v_addr += page_alignment;
@@ -98,23 +243,21 @@ uintptr_t PagingTableKernel::map_user_to_kernel(const uintptr_t user_vaddr, cons
     return k_v_addr;
 }
 
-void PagingTableKernel::unmap_user_to_kernel(uintptr_t kernel_vaddr, i64 length) {
-    uintptr_t working_addr = kernel_vaddr;
+void PagingTableKernel::unmap_user_to_kernel(const uintptr_t kernel_vaddr, const i64 length) {
     const size_t n_pages = (length + page_alignment - 1) >> base_address_shift;
     for (size_t i = 0; i < n_pages; i++) {
-        const auto v = virtual_address_t{working_addr};
-        page_table_entry_t &table = boot_page_tables[v.page_directory_index].table[v.page_table_index];
-        table = {};
-        working_addr += page_alignment;
+        if (const uintptr_t frame = get_phys_from_virtual(kernel_vaddr + i * page_alignment); frame != 0) {
+            page_frame_release(frame << base_address_shift);
+        }
     }
-    unreserve_kernel_v_addr_space(reinterpret_cast<void *>(kernel_vaddr),
-                                  reinterpret_cast<void *>(kernel_vaddr + (n_pages * page_alignment)));
+    unmap_range(kernel_vaddr, n_pages);
 }
 
 
 void PagingTableKernel::direct_map(const uintptr_t physical_address, const uintptr_t virt_addr, const bool writable,
                                    const bool user) {
     const auto v = virtual_address_t{virt_addr};
+    if (dir_is_large(v.page_directory_index)) split_large_page(v.page_directory_index);
     boot_page_directory[v.page_directory_index].present = true;
     boot_page_directory[v.page_directory_index].rw = true;
     page_table_entry_t &table = boot_page_tables[v.page_directory_index].table[v.page_table_index];
@@ -122,6 +265,7 @@ void PagingTableKernel::direct_map(const uintptr_t physical_address, const uintp
     table.physical_address = physical_address >> base_address_shift;
     table.rw = writable;
     table.user_access = user;
+    table.global = v.page_directory_index >= kernel_first_dir_idx;
 }
 
 /** Marks a section of the vbitmap as used
@@ -141,6 +285,7 @@ void PagingTableKernel::unreserve_kernel_v_addr_space(void *start, void *end) {
 
 PagingTableKernel::PagingTableKernel() {
     page_available_virtual_bitmap.init(paging_virt_bitmap_array, max_n_pages, true);
+    page_available_virtual_bitmap.init_summary(paging_virt_summary_array);
     // paging_directory = &boot_page_directory;
     // paging_tables = &boot_page_tables;
 }
@@ -148,31 +293,80 @@ PagingTableKernel::PagingTableKernel() {
 void *PagingTableKernel::mmap(const uintptr_t addr, const size_t length, int prot, int flags, int fd, size_t offset) {
     const size_t first_page = addr >> base_address_shift;
     const size_t num_pages = (length + page_alignment - 1) >> base_address_shift;
+    const int map_flags = (prot & PAGING_WRITABLE) | (flags & PAGING_USER);
 
-    const virtual_address_t ret_addr = {get_next_virtual_chunk(first_page, num_pages)};
+    // Big requests get a 4MiB aligned range so that whole directory entries can be mapped as large pages.
+    const bool try_large = paging_large_pages_enabled() && num_pages >= large_page_n_pages;
+    virtual_address_t ret_addr = {0};
+    if (try_large) ret_addr.raw = get_next_virtual_chunk_aligned(first_page, num_pages, large_page_n_pages);
+    if (ret_addr.raw == 0) ret_addr.raw = get_next_virtual_chunk(first_page, num_pages);
     if (ret_addr.raw == 0) return nullptr;
-    virtual_address_t working_addr = ret_addr;
-    for (size_t i = 0; i < num_pages; i++) {
-        if (!dir_entry_present(working_addr.page_directory_index)) {
-            // TODO: handle flag ints as bools here
-            assign_page_directory_entry(working_addr.page_directory_index, prot & PAGING_WRITABLE, flags & PAGING_USER);
-        }
 
+    size_t mapped = 0;
+    while (try_large && num_pages - mapped >= large_page_n_pages) {
+        const virtual_address_t working_addr = {ret_addr.raw + mapped * page_alignment};
+        if (working_addr.page_table_index != 0 || !table_is_empty(working_addr.page_directory_index)) break;
+        const uintptr_t phys = page_get_phys_run(large_page_n_pages); // buddy blocks are aligned to their size
+        if (phys == 0) break;
+        assign_large_page(phys, working_addr.page_directory_index, map_flags);
+        // Not from the zeroed pool: it holds single frames in no particular order, never an aligned 4MiB run.
+        art_string::memset(reinterpret_cast<void *>(working_addr.raw), 0, large_page_size);
+        page_zero_pool_record_misses(large_page_n_pages);
+        mapped += large_page_n_pages;
+    }
 
-        if (const auto phys_addr = page_get_next_phys_addr(); phys_addr != 0) {
-            assign_page_table_entry(
-                phys_addr,
-                working_addr,
-                true,
-                false
-            );
-        } else {
+    // Frames the idle task has already cleared go next so only the remainder has to be zeroed here.
+    phys_run_t zeroed[zero_pool_batch];
+    while (mapped < num_pages) {
+        const size_t n_runs = page_take_zeroed_frames(zeroed, zero_pool_batch, num_pages - mapped);
+        if (n_runs == 0) break;
+        size_t n_pages = 0;
+        for (size_t i = 0; i < n_runs; i++) n_pages += zeroed[i].n_pages;
+        map_range(ret_addr.raw + mapped * page_alignment, zeroed, n_runs, n_pages, map_flags);
+        mapped += n_pages;
+    }
+    const size_t first_dirty = mapped;
+
+    // Take the largest physical runs available, halving the request whenever the buddy allocator cannot satisfy it.
+    size_t run_len = MIN(num_pages - mapped, kmmap_max_run_pages);
+    while (mapped < num_pages) {
+        run_len = MIN(run_len, num_pages - mapped);
+        const phys_run_t run = {page_get_phys_run(run_len), run_len};
+        if (run.phys_addr == 0) {
+            if (run_len > 1) {
+                run_len /= 2;
+                continue;
+            }
+            if (mapped > 0) unassign_page_table_entries(ret_addr.raw >> base_address_shift, mapped);
             return nullptr;
         }
+        map_range(ret_addr.raw + mapped * page_alignment, &run, 1, run_len, map_flags);
+        mapped += run_len;
+    }
+
+    if (first_dirty < num_pages) {
+        art_string::memset(reinterpret_cast<void *>(ret_addr.raw + first_dirty * page_alignment), 0,
+                           (num_pages - first_dirty) * page_alignment);
+        page_zero_pool_record_misses(num_pages - first_dirty);
+    }
+    return reinterpret_cast<void *>(ret_addr.raw);
+}
 
-        working_addr.raw += page_alignment;
+
+void *PagingTableKernel::mmap_contiguous(const size_t length, uintptr_t *phys_addr) {
+    const size_t num_pages = (length + page_alignment - 1) >> base_address_shift;
+    const uintptr_t phys_start = page_get_phys_run(num_pages);
+    if (phys_start == 0) return nullptr;
+
+    const virtual_address_t ret_addr = {get_next_virtual_chunk(0, num_pages)};
+    if (ret_addr.raw == 0) {
+        page_free_phys_run(phys_start, num_pages);
+        return nullptr;
     }
+    const phys_run_t run = {phys_start, num_pages};
+    map_range(ret_addr.raw, &run, 1, num_pages, PAGING_WRITABLE);
 
+    if (phys_addr != nullptr) *phys_addr = phys_start;
     const auto p = reinterpret_cast<void *>(ret_addr.raw);
     art_string::memset(p, 0, length);
     return p;
@@ -184,6 +378,24 @@ void PagingTableKernel::identity_map(uintptr_t phys_addr, const size_t size, con
 
     const size_t num_pages = (size + page_alignment - 1) >> base_address_shift;
     for (size_t i = 0; i < num_pages; i++) {
+        // A 4MiB page covers this directory entry if it starts here, nothing else is mapped through it and either the
+        // range fills it or the rest of it is not RAM (e.g. the framebuffer).
+        if (paging_large_pages_enabled() && virtual_address.page_table_index == 0 &&
+            table_is_empty(virtual_address.page_directory_index) &&
+            (num_pages - i >= large_page_n_pages || !paging_phys_is_ram(phys_addr + large_page_size - 1))) {
+            assign_large_page(phys_addr, virtual_address.page_directory_index,
+                              (writable ? PAGING_WRITABLE : 0) | (user ? PAGING_USER : 0));
+            for (size_t j = 0; j < large_page_n_pages; j++) {
+                set_physical_bitmap_addr(phys_addr + j * page_alignment, false);
+            }
+            i += large_page_n_pages - 1;
+            phys_addr += large_page_size;
+            virtual_address.raw = phys_addr;
+            if (virtual_address.raw >> 12 >= max_n_pages || virtual_address.raw == 0) return;
+            continue;
+        }
+        if (dir_is_large(virtual_address.page_directory_index)) split_large_page(virtual_address.page_directory_index);
+
         // Every 1024 table entries requires a new dir entry.
         // if (!boot_page_tables[virtual_address.page_directory_index].table[virtual_address.page_table_index].present)
         // {
@@ -219,6 +431,23 @@ uintptr_t PagingTableKernel::get_next_virtual_chunk(size_t idx, const size_t n_p
     return idx << base_address_shift;
 }
 
+/**
+ * Like get_next_virtual_chunk but the returned address is a multiple of align_pages pages.
+ * @return virtual address or 0 if no such range is free
+ */
+uintptr_t PagingTableKernel::get_next_virtual_chunk_aligned(size_t idx, const size_t n_pages, const size_t align_pages) {
+    idx = MAX(idx, 768*1024);
+    while (true) {
+        const size_t found = page_available_virtual_bitmap.get_next_trues(idx, n_pages);
+        if (found == DBA_ERR_IDX) return 0;
+        const size_t aligned = (found + align_pages - 1) / align_pages * align_pages;
+        if (aligned == found || page_available_virtual_bitmap.get_next_trues(aligned, n_pages) == aligned) {
+            return aligned << base_address_shift;
+        }
+        idx = aligned;
+    }
+}
+
 uintptr_t PagingTableKernel::get_next_virtual_addr(const uintptr_t start_addr) {
     const uintptr_t min_addr = MAX(start_addr, 0xc0000000);
     const size_t idx = page_available_virtual_bitmap.get_next_true(min_addr >> base_address_shift);
@@ -233,6 +462,9 @@ bool PagingTableKernel::dir_entry_present(const size_t idx) {
 
 uintptr_t PagingTableKernel::get_phys_from_virtual(const uintptr_t v_addr) {
     const virtual_address_t lookup = {v_addr};
+    if (dir_is_large(lookup.page_directory_index)) {
+        return boot_page_directory[lookup.page_directory_index].page_table_entry_address + lookup.page_table_index;
+    }
     if (const auto entry = boot_page_tables[lookup.page_directory_index].table[lookup.page_table_index]; entry.
         present) {
         return entry.physical_address;
@@ -242,6 +474,16 @@ uintptr_t PagingTableKernel::get_phys_from_virtual(const uintptr_t v_addr) {
 
 page_table_entry_t PagingTableKernel::check_vmap_contents(const uintptr_t v_addr) {
     const virtual_address_t lookup = {v_addr};
+    if (dir_is_large(lookup.page_directory_index)) {
+        // describe the 4KiB page within the large page
+        const page_directory_4kb_t dir_entry = boot_page_directory[lookup.page_directory_index];
+        page_table_entry_t entry{};
+        entry.present = true;
+        entry.rw = dir_entry.rw;
+        entry.user_access = dir_entry.user_access;
+        entry.physical_address = dir_entry.page_table_entry_address + lookup.page_table_index;
+        return entry;
+    }
     if (const auto entry = boot_page_tables[lookup.page_directory_index].table[lookup.page_table_index]; entry.
         present) {
         return entry;
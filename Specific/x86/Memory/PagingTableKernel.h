@@ -27,6 +27,15 @@
 #include "paging.h"
 
 
+// Directory entries from here up map the kernel half and are shared with every user directory. Their pages are
+// marked global so they stay in the TLB across CR3 writes.
+constexpr size_t kernel_first_dir_idx = 768;
+
+// Largest physical run kmmap asks the frame allocator for at once (4MiB).
+constexpr size_t kmmap_max_run_pages = 1024;
+// Runs taken from the zeroed frame pool per map_range call.
+constexpr size_t zero_pool_batch = 32;
+
 class PagingTableKernel : public PagingTable {
 public:
     PagingTableKernel();
@@ -35,6 +44,8 @@ public:
 
     void *mmap(uintptr_t addr, size_t length, int prot, int flags, int fd, size_t offset) override;
 
+    void *mmap_contiguous(size_t length, uintptr_t *phys_addr);
+
     void identity_map(uintptr_t phys_addr, size_t size, bool writable, bool user);
 
     int munmap(void *addr, size_t length_bytes) override;
@@ -43,6 +54,8 @@ public:
 
     uintptr_t get_next_virtual_chunk(size_t idx, size_t n_pages);
 
+    uintptr_t get_next_virtual_chunk_aligned(size_t idx, size_t n_pages, size_t align_pages);
+
     uintptr_t get_next_virtual_addr(uintptr_t start_addr);
 
     bool dir_entry_present(size_t idx) override;
@@ -57,6 +70,18 @@ public:
 
     int unassign_page_table_entries(size_t start_idx, size_t n_pages) override;
 
+    void map_range(uintptr_t v_addr, const phys_run_t *runs, size_t n_runs, size_t n_pages, int flags);
+
+    void unmap_range(uintptr_t v_addr, size_t n_pages);
+
+    bool dir_is_large(size_t dir_idx);
+
+    bool table_is_empty(size_t dir_idx);
+
+    void assign_large_page(uintptr_t physical_addr, size_t dir_idx, int flags);
+
+    void split_large_page(size_t dir_idx);
+
     uintptr_t map_user_to_kernel(uintptr_t user_vaddr, i64 length);
 
     void unmap_user_to_kernel(uintptr_t kernel_vaddr, i64 length);
@@ -72,6 +97,7 @@ private:
     // page_directory_4kb_t paging_directory[page_table_len]__attribute__((aligned(page_alignment)));
     // page_table paging_tables[page_table_len]__attribute__((aligned(page_alignment)));
     u64 paging_virt_bitmap_array[paging_bitmap_n_DBs]{};
+    u64 paging_virt_summary_array[DenseBooleanArray<u64>::summary_words(max_n_pages)]{};
 };
 
 
@@ -22,9 +22,11 @@
 
 #include <art_string.h>
 #include <cmp_int.h>
+#include <CPU.h>
 #include <logging.h>
 #include <memory.h>
 #include <PagingTableKernel.h>
+#include <Files.h>
 
 extern page_directory_4kb_t boot_page_directory[];
 extern page_table boot_page_tables[];
@@ -35,7 +37,26 @@ constexpr size_t min_addr = 0x00100000;
 
 bool PagingTableUser::v_addr_is_used(const virtual_address_t v_addr) {
     if (!paging_directory[v_addr.page_directory_index].present) return false;
-    return paging_table[v_addr.page_directory_index].table[v_addr.page_table_index].present;
+    return paging_tables[v_addr.page_directory_index]->table[v_addr.page_table_index].present;
+}
+
+/** @return the table entry for page_idx or nullptr if its page table has not been allocated yet */
+page_table_entry_t *PagingTableUser::get_entry(const size_t page_idx) {
+    const size_t dir_idx = page_idx / page_table_len;
+    if (dir_idx >= kernel_first_dir_idx || paging_tables[dir_idx] == nullptr) return nullptr;
+    return &paging_tables[dir_idx]->table[page_idx % page_table_len];
+}
+
+PagingTableUser *PagingTableUser::all_tables = nullptr;
+
+/**
+ * Copy one kernel directory entry into every user directory. Kernel page tables are shared so this is only needed
+ * when the entry itself changes, e.g. to or from a 4MiB page.
+ */
+void PagingTableUser::sync_kernel_dir_entry(const size_t dir_idx) {
+    for (PagingTableUser *table = all_tables; table != nullptr; table = table->next_table) {
+        table->paging_directory[dir_idx] = boot_page_directory[dir_idx];
+    }
 }
 
 void PagingTableUser::map_all_kernel_pages() {
@@ -48,42 +69,53 @@ PagingTableUser::PagingTableUser() {
     paging_directory = static_cast<page_directory_4kb_t *>(art_alloc(sizeof(page_directory_4kb_t) * 1024,
                                                                      page_alignment));
     art_string::memset(paging_directory, 0, 1024 * sizeof(page_directory_4kb_t));
-    // Shares kernel tables at the top end, so only need bottom 768 for each user space program
-    paging_table = static_cast<page_table *>(art_alloc(sizeof(page_table) * 768, page_alignment));
-    art_string::memset(paging_table, 0, 768 * sizeof(page_table));
-
-    // TODO: for each page directory, set the table location
+    // Shares kernel tables at the top end. Tables for the bottom 768 entries are only allocated once something is
+    // mapped there, see append_page_table.
     map_all_kernel_pages();
-    for (size_t i = 0; i < 768; i++) {
-        paging_directory[i].page_table_entry_address = kernel_pages().get_phys_from_virtual(
-            reinterpret_cast<uintptr_t>(&paging_table[i]));
-    }
 
     // uintptr_t addr = PagingTableUser::get_phys_addr_of_page_dir();
     // asm volatile("mov %0, %%cr3" :: "r"(addr) : "memory");
+
+    // Nothing below 1MiB and nothing in the heap is ever handed out by mmap.
+    virtual_free.set_range(0, min_addr >> base_address_shift, false);
+    virtual_free.set_range(user_heap_start >> base_address_shift, user_heap_end >> base_address_shift, false);
+    virtual_free_summary = new u64[DenseBooleanArray<u64>::summary_words(user_n_pages)];
+    virtual_free.init_summary(virtual_free_summary);
+
+    next_table = all_tables;
+    all_tables = this;
 }
 
 PagingTableUser::~PagingTableUser() {
+    for (PagingTableUser **link = &all_tables; *link != nullptr; link = &(*link)->next_table) {
+        if (*link == this) {
+            *link = next_table;
+            break;
+        }
+    }
+    // Give back this process's hold on every frame it still maps. Shared frames only lose a holder, e.g. cached
+    // executable pages or pages a device is still reading into.
+    for (page_table *table: paging_tables) {
+        if (table == nullptr) continue;
+        for (const auto &tab_entry: table->table) {
+            if (tab_entry.present) page_frame_release(tab_entry.physical_address << base_address_shift);
+        }
+        art_free(table);
+    }
     art_free(paging_directory);
-    art_free(paging_table);
+    delete[] virtual_free_summary;
 }
 
 uintptr_t PagingTableUser::get_phys_from_virtual(uintptr_t v_addr) {
-    const virtual_address_t lookup = {v_addr};
-
-    if (const auto entry = paging_table[lookup.page_directory_index].table[lookup.page_table_index]; entry.present) {
-        return entry.physical_address << base_address_shift;
+    if (const auto entry = get_entry(v_addr >> base_address_shift); entry != nullptr && entry->present) {
+        return entry->physical_address << base_address_shift;
     }
     return 0;
 }
 
 page_table_entry_t PagingTableUser::check_vmap_contents(uintptr_t v_addr) {
-    const virtual_address_t lookup = {v_addr};
-    auto [table] = *reinterpret_cast<page_table *>(
-        paging_directory[lookup.page_directory_index].page_table_entry_address << base_address_shift);
-
-    if (const auto entry = table[lookup.page_table_index]; entry.present) {
-        return entry;
+    if (const auto entry = get_entry(v_addr >> base_address_shift); entry != nullptr && entry->present) {
+        return *entry;
     }
     return page_table_entry_t{};
 }
@@ -100,29 +132,74 @@ void *PagingTableUser::mmap(const uintptr_t addr, const size_t length, int prot,
     uintptr_t start_addr = MAX(addr, min_addr);
     const virtual_address_t ret_addr = get_next_virtual_chunk(start_addr, num_pages);
     if (ret_addr.raw == 0) return nullptr;
-    virtual_address_t working_addr = ret_addr;
-    for (size_t i = 0; i < num_pages; i++) {
-        if (!dir_entry_present(working_addr.page_directory_index)) {
-            // TODO: handle flag ints as bools here
-            append_page_table(writeable, true);
+    if (flags & MAP_PRIVATE) {
+        // Anonymous private memory is only backed once it is touched, see handle_page_fault.
+        if (!assign_demand_zero(ret_addr.raw, num_pages, writeable)) return nullptr;
+    } else if (!map_pages(ret_addr.raw, num_pages, writeable)) return nullptr;
+
+    return reinterpret_cast<void *>(ret_addr.raw);
+}
+
+/** Map fresh zeroed pages into this process, which must be the current one. Frames come from the idle task's zeroed
+ * pool where possible and are otherwise cleared here after mapping.
+ */
+bool PagingTableUser::map_pages(const uintptr_t v_addr, const size_t n_pages, const bool writeable) {
+    virtual_address_t working_addr = {v_addr};
+    size_t n_dirty = 0;
+    for (size_t i = 0; i < n_pages; i++) {
+        if (!dir_entry_present(working_addr.page_directory_index) &&
+            append_page_table(working_addr.page_directory_index, writeable, true) == nullptr) {
+            return false;
         }
 
-        if (uintptr_t phys_addr = page_get_next_phys_addr(); phys_addr != 0) {
+        phys_run_t zeroed{};
+        const bool from_pool = page_take_zeroed_frames(&zeroed, 1, 1) == 1;
+        if (uintptr_t phys_addr = from_pool ? zeroed.phys_addr : page_get_next_phys_addr(); phys_addr != 0) {
             assign_page_table_entries(
                 phys_addr,
                 working_addr.raw,
                 writeable, true
             );
         } else {
-            return nullptr;
+            return false;
+        }
+        if (!from_pool) {
+            art_string::memset(reinterpret_cast<void *>(working_addr.raw), 0, page_alignment);
+            n_dirty++;
         }
 
         working_addr.raw += page_alignment;
     }
+    page_zero_pool_record_misses(n_dirty);
+    return true;
+}
 
-    const auto p = reinterpret_cast<void *>(ret_addr.raw);
-    art_string::memset(p, 0, length);
-    return p;
+/** Move the end of the process heap like unix sbrk. The heap only ever grows or shrinks at its end so the pages backing
+ * it are mapped or unmapped a whole run at a time rather than through the mmap search. New heap pages are demand-zero.
+ *
+ * @param increment bytes to grow by, negative to shrink and 0 to query the current end
+ * @return the previous end of the heap or (void*)-1 on failure
+ */
+void *PagingTableUser::sbrk(const intptr_t increment) {
+    const uintptr_t old_brk = heap_brk;
+    const uintptr_t new_brk = old_brk + increment;
+    if (increment > 0 ? new_brk < old_brk || new_brk > user_heap_end : new_brk > old_brk || new_brk < user_heap_start) {
+        return reinterpret_cast<void *>(-1);
+    }
+
+    const uintptr_t new_mapped_end = (new_brk + page_alignment - 1) & ~(page_alignment - 1);
+    if (new_mapped_end > heap_mapped_end) {
+        const size_t n_pages = (new_mapped_end - heap_mapped_end) >> base_address_shift;
+        if (!assign_demand_zero(heap_mapped_end, n_pages, true)) {
+            return reinterpret_cast<void *>(-1);
+        }
+    } else if (new_mapped_end < heap_mapped_end) {
+        unassign_page_table_entries(new_mapped_end >> base_address_shift,
+                                    (heap_mapped_end - new_mapped_end) >> base_address_shift);
+    }
+    heap_mapped_end = new_mapped_end;
+    heap_brk = new_brk;
+    return reinterpret_cast<void *>(old_brk);
 }
 
 int PagingTableUser::munmap(void *addr, const size_t length_bytes) {
@@ -131,61 +208,183 @@ int PagingTableUser::munmap(void *addr, const size_t length_bytes) {
         (length_bytes + page_alignment - 1) >> base_address_shift); // this rounds up
 }
 
-page_table *PagingTableUser::append_page_table(const bool writable, const bool user) {
-    // TODO: get next free instead
-
-    return nullptr;
-    // const auto new_table_loc = reinterpret_cast<uintptr_t>(art_alloc(sizeof(page_table), page_alignment));
-    // size_t dir_idx = 0;
-    // for (; dir_idx < page_table_len && !paging_directory[dir_idx].present; dir_idx++)
-    // {
-    //     // empty
-    // }
-    // paging_directory[dir_idx] = {
-    //     1,
-    //     writable,
-    //     user,
-    //     0,
-    //     0,
-    //     0,
-    //     0,
-    //     0,
-    //     0,
-    //     new_table_loc >> base_address_shift, // TODO: this is meant to be a physical memory address
-    // };
-    // return reinterpret_cast<page_table*>(new_table_loc);
+/**
+ * Allocate the page table for directory entry dir_idx and point the entry at it.
+ * @return the new table or nullptr if there is no memory for it
+ */
+page_table *PagingTableUser::append_page_table(const size_t dir_idx, const bool writable, const bool user) {
+    if (dir_idx >= kernel_first_dir_idx) return nullptr;
+    if (paging_tables[dir_idx] != nullptr) return paging_tables[dir_idx];
+    auto *table = static_cast<page_table *>(art_alloc(sizeof(page_table), page_alignment));
+    if (table == nullptr) return nullptr;
+    art_string::memset(table, 0, sizeof(page_table));
+    paging_tables[dir_idx] = table;
+
+    auto &dir_entry = paging_directory[dir_idx];
+    dir_entry.page_table_entry_address = kernel_pages().get_phys_from_virtual(reinterpret_cast<uintptr_t>(table));
+    dir_entry.rw = writable;
+    dir_entry.user_access = user;
+    dir_entry.present = true;
+    return table;
 }
 
 
 void PagingTableUser::assign_page_table_entries(const uintptr_t physical_addr, const uintptr_t virt_addr,
                                                 const bool writable, const bool user) {
     auto v_addr = virtual_address_t{virt_addr};
+    if (append_page_table(v_addr.page_directory_index, writable, true) == nullptr) {
+        LOG("Could not allocate a page table for ", virt_addr);
+        return;
+    }
     auto tab_entry = page_table_entry_t{};
     tab_entry.present = true;
     tab_entry.physical_address = physical_addr >> base_address_shift;
     tab_entry.rw = writable;
     tab_entry.user_access = true;
-    paging_directory[v_addr.page_directory_index].present = true;
     paging_directory[v_addr.page_directory_index].rw |= writable;
-    paging_directory[v_addr.page_directory_index].user_access = true;
-    paging_table[v_addr.page_directory_index].table[v_addr.page_table_index] = tab_entry;
+    paging_tables[v_addr.page_directory_index]->table[v_addr.page_table_index] = tab_entry;
+    virtual_free.set_bit(virt_addr >> base_address_shift, false);
     set_physical_bitmap_addr(physical_addr, false);
     // TODO: HUGE ISSUE: I NEED A WAY TO SAFELY FREE ALL THIS MEMORY!
 }
 
-int PagingTableUser::unassign_page_table_entries(size_t start_idx, size_t n_pages) {
-    for (size_t i = start_idx; i < start_idx + n_pages; i++) {
-        auto [table] = *reinterpret_cast<page_table *>(
-            paging_directory[i / 1024].page_table_entry_address << base_address_shift);
-        auto *tab_entry = &table[i % 1024];
-        if (!tab_entry->present)return -1;
+/**
+ * Reserve n_pages pages from virt_addr without backing them. Each entry is left not present but marked demand-zero, so
+ * the first access faults and handle_page_fault maps a zeroed frame. Pages which are already mapped are left alone.
+ * @return false if a page table could not be allocated
+ */
+bool PagingTableUser::assign_demand_zero(const uintptr_t virt_addr, const size_t n_pages, const bool writable) {
+    const size_t first_idx = virt_addr >> base_address_shift;
+    for (size_t i = first_idx; i < first_idx + n_pages; i++) {
+        if (append_page_table(i / page_table_len, writable, true) == nullptr) return false;
+        paging_directory[i / page_table_len].rw |= writable;
+        auto *tab_entry = &paging_tables[i / page_table_len]->table[i % page_table_len];
+        if (tab_entry->present) continue;
+        *tab_entry = page_table_entry_t{};
+        tab_entry->rw = writable;
+        tab_entry->user_access = true;
+        tab_entry->OS_data = PAGE_OS_DEMAND_ZERO;
+    }
+    const size_t end_idx = first_idx + n_pages;
+    if (n_pages > 0) virtual_free.set_range(first_idx, end_idx, false);
+    return true;
+}
+
+/**
+ * Map a frame which is also mapped elsewhere, e.g. a cached executable page, read-only. The frame gains a holder which
+ * unmapping gives back.
+ * @param copy_on_write give this process a private copy on the first write instead of faulting
+ */
+void PagingTableUser::assign_shared_page(const uintptr_t physical_addr, const uintptr_t virt_addr,
+                                         const bool copy_on_write) {
+    page_frame_share(physical_addr);
+    assign_page_table_entries(physical_addr, virt_addr, false, true);
+    if (copy_on_write) {
+        paging_directory[virt_addr >> 22].rw = true;
+        get_entry(virt_addr >> base_address_shift)->OS_data = PAGE_OS_COPY_ON_WRITE;
+    }
+}
+
+/* Replace a shared copy-on-write frame with a private writable copy of it. */
+bool PagingTableUser::copy_on_write(const uintptr_t v_addr, page_table_entry_t *tab_entry) {
+    const uintptr_t page_addr = v_addr & ~(page_alignment - 1);
+    const uintptr_t old_phys = tab_entry->physical_address << base_address_shift;
+    if (page_frame_share_count(old_phys) > 0) {
+        const uintptr_t new_phys = page_get_next_phys_addr();
+        if (new_phys == 0) return false;
+        void *copy = kmap_physical(new_phys, page_alignment);
+        if (copy == nullptr) {
+            page_frame_release(new_phys);
+            return false;
+        }
+        art_string::memcpy(copy, reinterpret_cast<void *>(page_addr), page_alignment);
+        kunmap_physical(copy, page_alignment);
+        page_frame_release(old_phys);
+        tab_entry->physical_address = new_phys >> base_address_shift;
+    } // otherwise every other holder has gone and this process can keep the frame
+    tab_entry->OS_data = 0;
+    tab_entry->rw = true;
+    invlpg(page_addr);
+    return true;
+}
+
+/**
+ * Back a demand-zero page on first touch or copy a copy-on-write page on first write. Must run in this process's
+ * address space.
+ * @param err_code page fault error code
+ * @return true if the page is now mapped
+ */
+bool PagingTableUser::handle_page_fault(const uintptr_t v_addr, const u32 err_code) {
+    auto *tab_entry = get_entry(v_addr >> base_address_shift);
+    if (tab_entry == nullptr) return false;
+    if (err_code & 0x1) { // protection fault on a present page
+        if (!(err_code & 0x2) || !(tab_entry->OS_data & PAGE_OS_COPY_ON_WRITE)) return false;
+        return copy_on_write(v_addr, tab_entry);
+    }
+    if (tab_entry->present || !(tab_entry->OS_data & PAGE_OS_DEMAND_ZERO)) return false;
+
+    phys_run_t zeroed{};
+    const bool from_pool = page_take_zeroed_frames(&zeroed, 1, 1) == 1;
+    const uintptr_t phys_addr = from_pool ? zeroed.phys_addr : page_get_next_phys_addr();
+    if (phys_addr == 0) return false;
+
+    tab_entry->OS_data = 0;
+    tab_entry->physical_address = phys_addr >> base_address_shift;
+    tab_entry->present = true;
+    if (!from_pool) {
+        art_string::memset(reinterpret_cast<void *>(v_addr & ~(page_alignment - 1)), 0, page_alignment);
+        page_zero_pool_record_misses(1);
+    }
+    return true;
+}
+
+/**
+ * Make every page of a buffer present and privately writable before a device writes into its frames, because the
+ * device does not fault. Demand-zero pages are backed and copy-on-write pages copied now instead of on first touch.
+ * Must run in this process's address space.
+ * @return false if part of the buffer is not mapped, not writable or memory ran out
+ */
+bool PagingTableUser::prepare_write_target(const uintptr_t v_addr, const size_t n_bytes) {
+    const uintptr_t end = v_addr + n_bytes;
+    for (uintptr_t page = v_addr & ~(page_alignment - 1); page < end; page += page_alignment) {
+        const auto *tab_entry = get_entry(page >> base_address_shift);
+        if (tab_entry == nullptr) return false;
+        if (!tab_entry->present && !handle_page_fault(page, 0x6)) return false; // user write to a missing page
+        if (!tab_entry->rw && !handle_page_fault(page, 0x7)) return false; // user write to a read-only page
+    }
+    return true;
+}
 
-        const size_t phys_idx = tab_entry->physical_address;
+int PagingTableUser::unassign_page_table_entries(const size_t start_idx, const size_t n_pages) {
+    size_t i = start_idx;
+    int ret = 0;
+    for (; i < start_idx + n_pages; i++) {
+        auto *tab_entry = get_entry(i);
+        if (tab_entry != nullptr && !tab_entry->present && tab_entry->OS_data & PAGE_OS_DEMAND_ZERO) {
+            tab_entry->raw = 0; // never touched so there is no frame to free
+            continue;
+        }
+        if (tab_entry == nullptr || !tab_entry->present) {
+            ret = -1;
+            break;
+        }
 
-        set_physical_bitmap_idx(phys_idx, true);
+        page_frame_release(tab_entry->physical_address << base_address_shift);
         tab_entry->raw = 0;
     }
-    return 0;
+    tlb_flush_range(start_idx << base_address_shift, i - start_idx);
+    release_virtual_range(start_idx, i);
+    return ret;
+}
+
+/** Give pages [start_idx, end_idx) back to the mmap search. The heap range stays reserved for sbrk. */
+void PagingTableUser::release_virtual_range(const size_t start_idx, const size_t end_idx) {
+    constexpr size_t heap_first = user_heap_start >> base_address_shift;
+    constexpr size_t heap_last = user_heap_end >> base_address_shift;
+    const size_t below_heap_end = MIN(end_idx, heap_first);
+    const size_t above_heap_start = MAX(start_idx, heap_last);
+    if (start_idx < below_heap_end) virtual_free.set_range(start_idx, below_heap_end, true);
+    if (above_heap_start < end_idx) virtual_free.set_range(above_heap_start, end_idx, true);
 }
 
 
@@ -194,26 +393,18 @@ bool PagingTableUser::dir_entry_present(const size_t idx) {
 }
 
 virtual_address_t PagingTableUser::get_next_virtual_addr(const uintptr_t start_addr) {
-    auto working_addr = virtual_address_t(start_addr);
-    while (v_addr_is_used(working_addr) && working_addr.raw < max_addr) {
-        working_addr.raw += page_alignment;
-    }
-    return working_addr;
+    const size_t idx = virtual_free.get_next_true(start_addr >> base_address_shift);
+    if (idx == DBA_ERR_IDX) return virtual_address_t{};
+    return virtual_address_t{idx << base_address_shift};
 }
 
+/**
+ * Find the first run of n_pages unmapped pages at or after start_addr. The search uses this process's free page map so
+ * its cost does not depend on how much is already mapped.
+ * @return start of the run or 0 if there is none
+ */
 virtual_address_t PagingTableUser::get_next_virtual_chunk(const uintptr_t start_addr, const size_t n_pages) {
-    virtual_address_t ret_addr = get_next_virtual_addr(start_addr);
-    auto working_addr = ret_addr;
-    size_t n_sequential = 0;
-    while (n_sequential < n_pages && working_addr.raw < max_addr) {
-        working_addr.raw += page_alignment;
-        if (v_addr_is_used(working_addr)) {
-            ret_addr = get_next_virtual_addr(working_addr.raw);
-            working_addr = ret_addr;
-            continue;
-        }
-        n_sequential++;
-    }
-    if (n_sequential == n_pages)return ret_addr;
-    return virtual_address_t{};
+    const size_t idx = virtual_free.get_next_trues(start_addr >> base_address_shift, n_pages);
+    if (idx == DBA_ERR_IDX) return virtual_address_t{};
+    return virtual_address_t{idx << base_address_shift};
 }
@@ -21,9 +21,18 @@
 #ifndef PAGINGTABLEUSER_H
 #define PAGINGTABLEUSER_H
 
+#include <DenseBooleanArray.h>
+
 #include "PagingTable.h"
+#include "PagingTableKernel.h"
 #include "paging.h"
 
+// Virtual address range reserved for the brk-style heap of each process. mmap never hands out addresses in here.
+constexpr uintptr_t user_heap_start = 0x40000000;
+constexpr uintptr_t user_heap_end = 0x80000000;
+// Pages below the kernel half, i.e. the size of each process's free virtual page map.
+constexpr size_t user_n_pages = 0xc0000000 >> base_address_shift;
+
 class PagingTableUser : public PagingTable
 {
 public:
@@ -39,13 +48,29 @@ public:
     uintptr_t get_phys_addr_of_page_dir() override;
     void* mmap(uintptr_t addr, size_t length, int prot, int flags, int fd, size_t offset) override;
     int munmap(void* addr, size_t length_bytes) override;
-    page_table* append_page_table(bool writable, bool user);
+    void* sbrk(intptr_t increment);
+    page_table* append_page_table(size_t dir_idx, bool writable, bool user);
     void assign_page_table_entries(uintptr_t physical_addr, uintptr_t virt_addr, bool writable, bool user);
+    bool assign_demand_zero(uintptr_t virt_addr, size_t n_pages, bool writable);
+    void assign_shared_page(uintptr_t physical_addr, uintptr_t virt_addr, bool copy_on_write);
+    bool handle_page_fault(uintptr_t v_addr, u32 err_code);
+    bool prepare_write_target(uintptr_t v_addr, size_t n_bytes);
     int unassign_page_table_entries(size_t start_idx, size_t n_pages) override;
+    static void sync_kernel_dir_entry(size_t dir_idx);
 
 private:
+    static PagingTableUser* all_tables; // every live user directory, so kernel directory changes can be copied in
+    PagingTableUser* next_table = nullptr;
+    bool map_pages(uintptr_t v_addr, size_t n_pages, bool writeable);
+    void release_virtual_range(size_t start_idx, size_t end_idx);
+    page_table_entry_t* get_entry(size_t page_idx);
+    bool copy_on_write(uintptr_t v_addr, page_table_entry_t* tab_entry);
     page_directory_4kb_t* paging_directory = nullptr;
-    page_table* paging_table = nullptr;
+    page_table* paging_tables[kernel_first_dir_idx]{}; // allocated when a directory entry is first used
+    uintptr_t heap_brk = user_heap_start; // current end of the heap as seen by the process
+    uintptr_t heap_mapped_end = user_heap_start; // page aligned end of the pages backing the heap
+    DenseBooleanArray<u64> virtual_free{user_n_pages, true}; // true for each page mmap may still hand out
+    u64* virtual_free_summary = nullptr;
     // bool v_addr_is_used(virtual_address_t v_addr) const;
 };
 
@@ -30,8 +30,13 @@
 #include "logging.h"
 #include "string.h"
 #include "cmp_int.h"
-#include "DenseBooleanArray.h"
+#include "BuddyBitmap.h"
 #include "Scheduler.h"
+#include "CPU.h"
+#include "CPUID.h"
+#include "alloc_stats.h"
+#include "TSC.h"
+#include "art_string.h"
 
 
 /// Each table is 4k in size, and is page aligned i.e. 4k aligned. They consists of 1024 32 bit entries.
@@ -53,33 +58,282 @@ extern unsigned char kernel_start;
 unsigned char *kernel_start_loc = &kernel_start;
 
 
-// bitmaps used to keep track of the next virtual and physical pages available.
-// These are the same during identity mapping, but diverge when user space programs make malloc calls
-// 4GB worth of 4096 pages. Set all to false. Processing the multiboot2 memory_map will set the necessary bits.
+// Physical frames are handed out by a buddy allocator so that contiguous runs (e.g. DMA buffers) are cheap to find.
+// Blocks go up to 4MiB. Every frame starts allocated; processing the multiboot2 memory_map frees usable RAM.
+constexpr size_t phys_frame_max_order = 10;
+u64 paging_phys_buddy_array[BuddyBitmap<phys_frame_max_order>::storage_words(max_n_pages)];
+BuddyBitmap<phys_frame_max_order> physical_frames;
 
-u64 paging_phys_bitmap_array[paging_bitmap_n_DBs];
-DenseBooleanArray<u64> page_available_physical_bitmap;
 
+static size_t pop_zeroed_frames(phys_run_t *runs, size_t max_runs, size_t n_pages);
 
 uintptr_t page_get_next_phys_addr() {
-    const size_t idx = page_available_physical_bitmap.get_next_true();
-    if (idx == DBA_ERR_IDX) return 0;
+    const size_t idx = physical_frames.alloc(0);
+    if (idx == BUDDY_ERR_IDX) {
+        // fall back on the zeroed pool before giving up. Not a hit, the caller did not need the frame cleared.
+        phys_run_t run{};
+        if (pop_zeroed_frames(&run, 1, 1) == 0) return 0;
+        return run.phys_addr;
+    }
+    return idx << base_address_shift;
+}
+
+uintptr_t page_get_phys_run(const size_t n_pages) {
+    if (n_pages > size_t{1} << phys_frame_max_order) return 0;
+    const size_t idx = physical_frames.alloc_run(n_pages);
+    if (idx == BUDDY_ERR_IDX) return 0;
     return idx << base_address_shift;
 }
 
+void page_free_phys_run(const uintptr_t phys_addr, const size_t n_pages) {
+    physical_frames.free_range(phys_addr >> base_address_shift, n_pages);
+}
+
+size_t page_get_n_free_phys() {
+    return physical_frames.get_free_units();
+}
+
+// Holders of each frame beyond its first owner, i.e. 0 for a frame mapped in one place. A count which reaches the
+// maximum is never decremented again so the frame leaks rather than being freed while still mapped.
+u8 phys_frame_shares[max_n_pages];
+constexpr u8 phys_frame_shares_max = 0xff;
+
+/** Add a holder to an allocated frame, e.g. when mapping it into another address space. */
+void page_frame_share(const uintptr_t phys_addr) {
+    u8 &shares = phys_frame_shares[phys_addr >> base_address_shift];
+    if (shares < phys_frame_shares_max) shares++;
+}
+
+/**
+ * Drop one holder of a frame and free it if that was the last.
+ * @return true if the frame was freed
+ */
+bool page_frame_release(const uintptr_t phys_addr) {
+    const size_t idx = phys_addr >> base_address_shift;
+    if (phys_frame_shares[idx] == phys_frame_shares_max) return false;
+    if (phys_frame_shares[idx] > 0) {
+        phys_frame_shares[idx]--;
+        return false;
+    }
+    return physical_frames.free(idx, 0);
+}
+
+/** @return number of holders of the frame beyond the first */
+size_t page_frame_share_count(const uintptr_t phys_addr) {
+    return phys_frame_shares[phys_addr >> base_address_shift];
+}
+
+
+// Frames zeroed ahead of time by the idle task. mmap takes these first so it only has to clear what the pool cannot
+// supply. Frames in the pool count as allocated as far as the buddy allocator is concerned.
+u32 zero_pool_frames[zero_pool_capacity];
+size_t zero_pool_count = 0;
+unsigned long zero_pool_hits = 0;
+unsigned long zero_pool_misses = 0;
+uintptr_t zero_pool_scratch = 0; // kernel page the idle task maps each frame to while clearing it
+
+
+/* Pop up to n_pages frames from the pool, merging neighbours into runs. @return number of runs written */
+static size_t pop_zeroed_frames(phys_run_t *runs, const size_t max_runs, const size_t n_pages) {
+    const bool interrupts_enabled = get_interrupts_are_enabled();
+    if (interrupts_enabled) disable_interrupts();
+    size_t n_runs = 0;
+    size_t taken = 0;
+    while (taken < n_pages && zero_pool_count > 0) {
+        const uintptr_t phys = static_cast<uintptr_t>(zero_pool_frames[zero_pool_count - 1]) << base_address_shift;
+        if (n_runs > 0 && runs[n_runs - 1].phys_addr + runs[n_runs - 1].n_pages * page_alignment == phys) {
+            runs[n_runs - 1].n_pages++;
+        } else if (n_runs < max_runs) {
+            runs[n_runs++] = {phys, 1};
+        } else {
+            break;
+        }
+        zero_pool_count--;
+        taken++;
+    }
+    if (interrupts_enabled) enable_interrupts();
+    return n_runs;
+}
+
+/**
+ * Pop up to n_pages pre-zeroed frames for a caller which needs them cleared, merging neighbours into runs.
+ * @param runs destination for at most max_runs runs
+ * @param max_runs capacity of runs
+ * @param n_pages most pages wanted
+ * @return number of runs written
+ */
+size_t page_take_zeroed_frames(phys_run_t *runs, const size_t max_runs, const size_t n_pages) {
+    const size_t n_runs = pop_zeroed_frames(runs, max_runs, n_pages);
+    for (size_t i = 0; i < n_runs; i++) zero_pool_hits += runs[i].n_pages;
+    return n_runs;
+}
+
+/** Record pages which had to be cleared by the caller because the pool was empty. */
+void page_zero_pool_record_misses(const size_t n_pages) {
+    zero_pool_misses += n_pages;
+}
+
+/**
+ * Clear one free frame and add it to the pool. Called from the idle task so interrupts stay enabled while clearing.
+ * @return false if the pool is full or there is no free memory
+ */
+bool page_zero_pool_fill_one() {
+    if (zero_pool_scratch == 0 || zero_pool_count >= zero_pool_capacity) return false;
+
+    bool interrupts_enabled = get_interrupts_are_enabled();
+    if (interrupts_enabled) disable_interrupts();
+    const size_t idx = physical_frames.alloc(0);
+    if (interrupts_enabled) enable_interrupts();
+    if (idx == BUDDY_ERR_IDX) return false;
+
+    kernel_pages().direct_map(idx << base_address_shift, zero_pool_scratch, true, false);
+    invlpg(zero_pool_scratch);
+    art_string::memset(reinterpret_cast<void *>(zero_pool_scratch), 0, page_alignment);
+
+    interrupts_enabled = get_interrupts_are_enabled();
+    if (interrupts_enabled) disable_interrupts();
+    if (zero_pool_count < zero_pool_capacity) {
+        zero_pool_frames[zero_pool_count++] = idx;
+    } else {
+        physical_frames.free(idx, 0);
+    }
+    if (interrupts_enabled) enable_interrupts();
+    return true;
+}
+
+void page_zero_pool_get_stats(alloc_stats_t *dest) {
+    dest->zero_pool_hits = zero_pool_hits;
+    dest->zero_pool_misses = zero_pool_misses;
+    dest->zero_pool_frames = zero_pool_count;
+    dest->zero_pool_capacity = zero_pool_capacity;
+    dest->phys_frames_free = physical_frames.get_free_units();
+}
+
+void page_zero_pool_log_stats() {
+    const unsigned long total = zero_pool_hits + zero_pool_misses;
+    LOG("Zeroed frame pool: ", zero_pool_count, "/", zero_pool_capacity, " frames, ", zero_pool_hits, " hits ",
+        zero_pool_misses, " misses (", total ? zero_pool_hits * 100 / total : 0, "% hit rate)");
+}
+
+/* Set up the kernel page used to clear pool frames. Its page table has to exist before any process copies the
+ * kernel directory entries. */
+void page_zero_pool_init() {
+    zero_pool_scratch = kernel_pages().get_next_virtual_chunk(0, 1);
+    if (zero_pool_scratch == 0) return;
+    const virtual_address_t v = {zero_pool_scratch};
+    if (!kernel_pages().dir_entry_present(v.page_directory_index)) {
+        kernel_pages().assign_page_directory_entry(v.page_directory_index, true, false);
+    }
+    kernel_pages().reserve_kernel_v_addr_space(reinterpret_cast<void *>(zero_pool_scratch),
+                                               reinterpret_cast<void *>(zero_pool_scratch + page_alignment));
+}
+
 
 void set_physical_bitmap_addr(const uintptr_t physical_addr, const bool state) {
-    page_available_physical_bitmap.set_bit(physical_addr >> base_address_shift, state);
+    set_physical_bitmap_idx(physical_addr >> base_address_shift, state);
 }
 
 void set_physical_bitmap_idx(const size_t phys_idx, const bool state) {
-    page_available_physical_bitmap.set_bit(phys_idx, state);
+    if (state) {
+        physical_frames.free(phys_idx, 0);
+    } else {
+        physical_frames.reserve(phys_idx);
+    }
 }
 
 uintptr_t get_kernal_page_dir() {
     return kernel_pages().get_phys_addr_of_page_dir();
 }
 
+bool global_pages_enabled = false;
+
+/* Flush every TLB entry. A CR3 write leaves global entries, toggling CR4.PGE does not. */
+void tlb_flush_all() {
+    if (global_pages_enabled) {
+        const u32 cr4 = get_cr4();
+        set_cr4(cr4 & ~(0x1 << 7));
+        set_cr4(cr4);
+    } else {
+        set_cr3(get_cr3());
+    }
+}
+
+/**
+ * Drop stale TLB entries for a range of pages whose mappings changed.
+ * @param v_addr first virtual address in the range
+ * @param n_pages number of pages
+ */
+void tlb_flush_range(const uintptr_t v_addr, const size_t n_pages) {
+    if (n_pages > tlb_flush_full_threshold) {
+        if (v_addr >= 0xc0000000) tlb_flush_all();
+        else set_cr3(get_cr3()); // user mappings are never global
+        return;
+    }
+    for (size_t i = 0; i < n_pages; i++) {
+        invlpg(v_addr + i * page_alignment);
+    }
+}
+
+bool large_pages_enabled = false;
+
+/**
+ * Turn on 4MiB pages (CR4.PSE) if CPUID reports them.
+ */
+void enable_large_pages() {
+    if (!(cpuid_get_feature_info()->edx & 0x1 << 3)) return;
+    set_cr4(get_cr4() | 0x1 << 4);
+    large_pages_enabled = true;
+}
+
+bool paging_large_pages_enabled() {
+    return large_pages_enabled;
+}
+
+/** Set CR4.PGE if the CPU supports it, so kernel half entries marked global survive CR3 writes. */
+void enable_global_pages() {
+    if (!(cpuid_get_feature_info()->edx & 0x1 << 13)) return;
+    set_cr4(get_cr4() | 0x1 << 7);
+    global_pages_enabled = true;
+}
+
+bool paging_global_pages_enabled() {
+    return global_pages_enabled;
+}
+
+/**
+ * Time n_switches address space switches, each followed by touching kernel pages as the code after a context switch
+ * would. Logs the ticks per switch for a CR3 reload with global pages off and on and for a skipped reload.
+ */
+void paging_benchmark_address_space_switch(const size_t n_switches) {
+    constexpr size_t n_touched = 64;
+    const auto touched = reinterpret_cast<volatile u8 *>(boot_page_tables);
+    const u32 cr3 = get_cr3();
+    const u32 cr4 = get_cr4();
+    const bool interrupts_enabled = get_interrupts_are_enabled();
+    if (interrupts_enabled) disable_interrupts();
+
+    u64 ticks[3] = {};
+    for (size_t mode = 0; mode < 3; mode++) {
+        set_cr4(mode == 0 ? cr4 & ~(0x1 << 7) : cr4);
+        const u64 start = TSC_get_ticks();
+        for (size_t i = 0; i < n_switches; i++) {
+            if (mode < 2) set_cr3(cr3);
+            for (size_t page = 0; page < n_touched; page++) (void)touched[page * page_alignment];
+        }
+        ticks[mode] = (TSC_get_ticks() - start) / n_switches;
+    }
+    set_cr4(cr4);
+
+    if (interrupts_enabled) enable_interrupts();
+    LOG("Address space switch benchmark (ticks per switch): reload ", ticks[0], ", reload with global pages ",
+        global_pages_enabled ? ticks[1] : ticks[0], ", skipped ", ticks[2]);
+}
+
+/** @return true if the address lies below the end of usable RAM reported by the memory map */
+bool paging_phys_is_ram(const uintptr_t phys_addr) {
+    return (phys_addr >> base_address_shift) < last_physical_idx;
+}
+
 void enable_paging() {
     auto addr = kernel_pages().get_phys_addr_of_page_dir() | 0xFFF; // TODO: shouldn't this be & 0xfffff000 ?
     __asm__ volatile ("mov %0, %%cr3" : : "r"(addr)); // set the cr3 to the paging_directory physical address
@@ -128,7 +382,9 @@ void dirty_ident_unmap(const uintptr_t start, const uintptr_t end) {
  *  This could use kernel end once sbrk is no longer a thing.
  */
 void mmap_init(multiboot2_tag_mmap *mmap) {
-    page_available_physical_bitmap.init(paging_phys_bitmap_array, max_n_pages, false);
+    physical_frames.init(paging_phys_buddy_array, max_n_pages);
+    enable_large_pages();
+    enable_global_pages();
 
     const auto brk_loc = reinterpret_cast<uintptr_t>(kernel_brk);
     const size_t n_entries = mmap->size / sizeof(multiboot2_mmap_entry);
@@ -136,12 +392,25 @@ void mmap_init(multiboot2_tag_mmap *mmap) {
     // first page after kernel image.
 
     // TODO: I Don't want it identitiy map if type 1!
-    // Loop through all entries and map appropriately
     dirty_ident_map(reinterpret_cast<uintptr_t>(mmap->entries[0]),
                     reinterpret_cast<uintptr_t>(mmap->entries[5]) + sizeof(multiboot2_mmap_entry));
+    // Find the end of RAM first so that identity_map sees the whole bound, see paging_phys_is_ram.
+    for (size_t i = 0; i < n_entries; i++) {
+        multiboot2_mmap_entry const *entry = mmap->entries[i];
+        if (entry->type != MULTIBOOT2_MEMORY_AVAILABLE) continue;
+        const u64 end_idx = MIN((entry->addr + entry->len) >> base_address_shift, u64{max_n_pages});
+        last_physical_idx = MAX(last_physical_idx, static_cast<size_t>(end_idx));
+    }
+    // Loop through all entries and map appropriately
     for (size_t i = 0; i < n_entries; i++) {
         multiboot2_mmap_entry const *entry = mmap->entries[i];
-        if (entry->type == 1) continue;
+        if (entry->type == MULTIBOOT2_MEMORY_AVAILABLE) {
+            // only hand out frames after the kernel image
+            const u64 first_idx = MAX(entry->addr, post_kernel_page - 0xc0000000) >> base_address_shift;
+            const u64 end_idx = MIN((entry->addr + entry->len) >> base_address_shift, u64{max_n_pages});
+            if (first_idx < end_idx) physical_frames.free_range(first_idx, end_idx - first_idx);
+            continue;
+        }
 
         if (entry->addr < brk_loc && entry->addr + entry->len > brk_loc) {
             // contains kernel
@@ -149,7 +418,6 @@ void mmap_init(multiboot2_tag_mmap *mmap) {
             kernel_pages().identity_map(entry->addr, brk_loc - entry->addr, false, false);
             main_region_start = entry->addr;
             main_region_end = entry->addr + entry->len;
-            last_physical_idx = main_region_end >> base_address_shift;
         } else {
             kernel_pages().identity_map(entry->addr, entry->len, false && entry->addr > 0, false);
         }
@@ -161,16 +429,9 @@ void mmap_init(multiboot2_tag_mmap *mmap) {
     // paging_identity_map(main_region_start, post_kernel_page - main_region_start, true, false);
     // kernel_pages().identity_map(0xf0000000, 0xffffffff - 0xf0000000, true, false);
 
-    // set upper limit in physical bitmap to extents of the avaialble
-    // TODO: this is not correct at all.
-    // page_available_physical_bitmap.set_range(0, post_kernel_page-0xc0000000, false);
-    page_available_physical_bitmap.set_range(
-        (post_kernel_page - 0xc0000000) >> base_address_shift,
-        (main_region_end - post_kernel_page - 0xc0000000) >> base_address_shift,
-        true
-    );
-
+    LOG("Paging: ", page_get_n_free_phys(), " physical frames available.");
     kernel_pages().reserve_kernel_v_addr_space(reinterpret_cast<void *>(0xc0000000), kernel_brk);
+    page_zero_pool_init();
 
 
     LOG("Paging: memory map processed.");
@@ -187,6 +448,36 @@ void *user_mmap(uintptr_t addr, size_t length, int prot, int flags, int fd, size
     return Scheduler::get().getCurrentPagingTable().mmap(addr, length, prot, flags, fd, offset);
 }
 
+/**
+ * Map physically contiguous, zeroed memory into the kernel, e.g. for DMA buffers. Free with kmunmap.
+ * @param length size in bytes
+ * @param phys_addr receives the physical address of the first byte
+ * @return virtual address or nullptr on failure
+ */
+void *kmmap_contiguous(const size_t length, uintptr_t *phys_addr) {
+    return kernel_pages().mmap_contiguous(length, phys_addr);
+}
+
+/**
+ * Map existing physical memory, e.g. a device region, into the kernel with 4KiB pages. The frames are not taken from
+ * or given back to the frame allocator.
+ * @param phys_addr page aligned physical address
+ * @param length size in bytes
+ * @return virtual address or nullptr on failure
+ */
+void *kmap_physical(const uintptr_t phys_addr, const size_t length) {
+    const size_t n_pages = (length + page_alignment - 1) >> base_address_shift;
+    const uintptr_t v_addr = kernel_pages().get_next_virtual_chunk(0, n_pages);
+    if (v_addr == 0) return nullptr;
+    const phys_run_t run = {phys_addr, n_pages};
+    kernel_pages().map_range(v_addr, &run, 1, n_pages, PAGING_WRITABLE);
+    return reinterpret_cast<void *>(v_addr);
+}
+
+void kunmap_physical(void *v_addr, const size_t length) {
+    kernel_pages().unmap_range(reinterpret_cast<uintptr_t>(v_addr), (length + page_alignment - 1) >> base_address_shift);
+}
+
 uintptr_t kget_mapping_target(void *v_addr) {
     return kernel_pages().get_phys_from_virtual(reinterpret_cast<uintptr_t>(v_addr)) * page_alignment;
 }
@@ -199,6 +490,22 @@ int user_munmap(void *addr, const size_t length_bytes) {
     return Scheduler::get().getCurrentPagingTable().munmap(addr, length_bytes);
 }
 
+/**
+ * Resolve a page fault at v_addr in the current user process if it touched a demand-zero page.
+ * @param err_code error code pushed by the CPU for vector 14
+ * @return true if a page was mapped and the faulting instruction can be retried
+ */
+bool user_page_fault(const uintptr_t v_addr, const u32 err_code) {
+    if (v_addr >= 0xc0000000) return false;
+    PagingTableUser *table = Scheduler::getCurrentUserPagingTable();
+    if (table == nullptr) return false;
+    return table->handle_page_fault(v_addr, err_code);
+}
+
+void *user_sbrk(const intptr_t increment) {
+    return Scheduler::get().getCurrentPagingTable().sbrk(increment);
+}
+
 void paging_identity_map(const uintptr_t phys_addr, const size_t size, const bool writable, const bool user) {
     kernel_pages().identity_map(phys_addr, size, writable, user);
 }
@@ -33,9 +33,27 @@ constexpr size_t max_n_pages = 0x100000;
 constexpr uintptr_t max_memory_addr = max_n_pages * page_alignment;
 extern uintptr_t main_region_end;
 
+/// A page directory entry with the PSE bit set maps one 4MiB page instead of pointing at a page table.
+constexpr size_t large_page_n_pages = page_table_len;
+constexpr size_t large_page_size = large_page_n_pages * page_alignment;
+
 constexpr int PAGING_WRITABLE = 0x1;
 constexpr int PAGING_USER = 0x2;
 
+// Global bit of a 4MiB directory entry, which page_directory_4kb_t counts as part of OS_data.
+constexpr u32 PAGE_DIR_LARGE_GLOBAL = 0x100;
+
+// page_table_entry_t::OS_data flag on a non-present entry: back this page with a zeroed frame on first touch.
+constexpr u32 PAGE_OS_DEMAND_ZERO = 0x1;
+// page_table_entry_t::OS_data flag on a read-only entry: copy the shared frame on the first write.
+constexpr u32 PAGE_OS_COPY_ON_WRITE = 0x2;
+
+// Frames kept cleared by the idle task for mmap (4MiB).
+constexpr size_t zero_pool_capacity = 1024;
+
+// Above this many pages a full TLB flush (CR3 reload) is cheaper than one invlpg per page.
+constexpr size_t tlb_flush_full_threshold = 32;
+
 constexpr size_t paging_bitmap_n_DBs = (max_n_pages + (64 - 1)) / 32;
 
 
@@ -50,7 +68,7 @@ union page_directory_4kb_t
         u32 cache_disable : 1 = false; // is caching disabled?
         u32 accessed : 1 = false; // Gets sets on access, has to be cleared manually by OS if used.
         u32 OS : 1 = false; // free bit available for OS use
-        u32 extended_page_size : 1 = false; // 4MB pages if set, 4KB if not. (Always not set in ArtOS).
+        u32 extended_page_size : 1 = false; // 4MB pages if set, 4KB if not. Only set when CR4.PSE is enabled.
         u32 OS_data : 4 = 0; // free nibble available for OS flags
         u32 page_table_entry_address : 20; // bits 12-31. 4KiB alignment means first 12 bits are always zero.
     };
@@ -92,6 +110,13 @@ union page_table_entry_t
 
 page_table_entry_t paging_check_contents(uintptr_t vaddr);
 
+/// A run of physically contiguous pages.
+struct phys_run_t
+{
+    uintptr_t phys_addr;
+    size_t n_pages;
+};
+
 struct page_table
 {
     page_table_entry_t table[page_table_len]; // u32
@@ -100,6 +125,7 @@ struct page_table
 void mmap_init(multiboot2_tag_mmap* mmap);
 //
 void* kmmap(uintptr_t addr, size_t length, int prot, int flags, int fd, size_t offset);
+void* kmmap_contiguous(size_t length, uintptr_t* phys_addr);
 uintptr_t kget_mapping_target(void* v_addr);
 int kmunmap(void* addr, size_t length);
 //
@@ -108,10 +134,30 @@ void paging_identity_map(uintptr_t phys_addr, size_t size, bool writable, bool u
 void paging_set_target_pid(size_t pid);
 
 uintptr_t page_get_next_phys_addr();
+uintptr_t page_get_phys_run(size_t n_pages);
+void page_free_phys_run(uintptr_t phys_addr, size_t n_pages);
+size_t page_get_n_free_phys();
+void page_frame_share(uintptr_t phys_addr);
+bool page_frame_release(uintptr_t phys_addr);
+size_t page_frame_share_count(uintptr_t phys_addr);
+
+struct alloc_stats_t;
+size_t page_take_zeroed_frames(phys_run_t* runs, size_t max_runs, size_t n_pages);
+void page_zero_pool_record_misses(size_t n_pages);
+bool page_zero_pool_fill_one();
+void page_zero_pool_get_stats(alloc_stats_t* dest);
+void page_zero_pool_log_stats();
 
 void set_physical_bitmap_addr(uintptr_t physical_addr, bool state);
 void set_physical_bitmap_idx(size_t phys_idx, bool state);
 uintptr_t get_kernal_page_dir();
+void tlb_flush_range(uintptr_t v_addr, size_t n_pages);
+bool paging_large_pages_enabled();
+bool paging_global_pages_enabled();
+void paging_benchmark_address_space_switch(size_t n_switches);
+bool paging_phys_is_ram(uintptr_t phys_addr);
+void* kmap_physical(uintptr_t phys_addr, size_t length);
+void kunmap_physical(void* v_addr, size_t length);
 
 void dirty_ident_map(uintptr_t start, uintptr_t end);
 void dirty_ident_unmap(uintptr_t start, uintptr_t end);
@@ -122,6 +168,8 @@ PagingTableKernel& kernel_pages();
 
 void *user_mmap(uintptr_t addr, size_t length, int prot, int flags, int fd, size_t offset);
 int user_munmap(void *addr, const size_t length_bytes);
+void *user_sbrk(intptr_t increment);
+bool user_page_fault(uintptr_t v_addr, u32 err_code);
 extern unsigned char* kernel_brk;
 
 #endif //PAGING_H
@@ -172,6 +172,13 @@ int LocalAPIC::start_timer_us(u32 us) const
     return static_cast<int>(n_LAPIC_ticks);
 }
 
+/* Cancel a pending one-shot. Writing an initial count of zero stops the timer without raising an interrupt. */
+void LocalAPIC::stop_timer() const
+{
+    if (!is_ready) return;
+    *reinterpret_cast<u32*>(base + TIMER_INITIAL_COUNT_OFFSET) = 0;
+}
+
 /* DEPENDS ON PIT and IDT */
 void LocalAPIC::configure_timer(const DIVISOR divisor)
 {
@@ -56,6 +56,7 @@ public:
     bool ready() const;
     int start_timer_ms(u32 ms) const;
     int start_timer_us(u32 us) const;
+    void stop_timer() const;
 private:
     uintptr_t base;
     LVT full_lvt;
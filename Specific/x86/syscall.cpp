@@ -24,6 +24,11 @@
 #include <Files.h>
 #include "memory.h"
 #include "paging.h"
+#include "PagingTableUser.h"
+#include "alloc_stats.h"
+#include "sched_stats.h"
+#include "cache_stats.h"
+#include "BlockCache.h"
 
 #include "EventQueue.h"
 #include "Scheduler.h"
@@ -53,6 +58,18 @@ void kwrite_error([[maybe_unused]] const char* buffer, [[maybe_unused]] unsigned
     WRITE(buffer, len);
 }
 
+/*
+ * Make a user buffer present and private before the kernel writes its output there. Kernel writes ignore read-only
+ * pages (CR0.WP is clear), so a copy-on-write page, e.g. in .data, would otherwise be written in place and change the
+ * cached executable image shared by every instance.
+ * @return false if the buffer is not mapped writable
+ */
+static bool kprepare_user_output(const uintptr_t dest, const size_t n_bytes)
+{
+    PagingTableUser* user_tables = Scheduler::getCurrentUserPagingTable();
+    return user_tables == nullptr || user_tables->prepare_write_target(dest, n_bytes);
+}
+
 int kget_time(tm* mytm)
 {
     return RTC::get().getTime(mytm);
@@ -235,6 +252,11 @@ void syscall_handler(cpu_registers_t* r)
         }
     case SYSCALL_t::GET_TIME:
         {
+            if (!kprepare_user_output(r->ebx, sizeof(tm)))
+            {
+                r->eax = -1;
+                break;
+            }
             r->eax = kget_time(reinterpret_cast<tm*>(r->ebx));
             break;
         }
@@ -254,6 +276,11 @@ void syscall_handler(cpu_registers_t* r)
             r->eax = user_munmap(reinterpret_cast<void*>(r->ebx), r->ecx);
             break;
         }
+    case SYSCALL_t::SBRK:
+        {
+            r->eax = reinterpret_cast<u32>(user_sbrk(static_cast<i32>(r->ebx)));
+            break;
+        }
     case SYSCALL_t::GET_CURRENT_CLOCK:
         {
             large_res = kget_current_clock();
@@ -271,6 +298,81 @@ void syscall_handler(cpu_registers_t* r)
             Scheduler::schedule(r);
             break;
         }
+    case SYSCALL_t::SET_PRIORITY:
+        {
+            r->eax = Scheduler::set_priority(Scheduler::getCurrentProcessID(), static_cast<int>(r->ebx));
+            break;
+        }
+    case SYSCALL_t::GET_ALLOC_STATS:
+        {
+            // no destination means dump to the log instead
+            if (r->ebx && !kprepare_user_output(r->ebx, sizeof(alloc_stats_t)))
+            {
+                r->eax = -1;
+                break;
+            }
+            if (r->ebx)
+            {
+                art_alloc_get_stats(reinterpret_cast<alloc_stats_t*>(r->ebx));
+                page_zero_pool_get_stats(reinterpret_cast<alloc_stats_t*>(r->ebx));
+            }
+            else
+            {
+                art_alloc_log_stats();
+                page_zero_pool_log_stats();
+            }
+            r->eax = 0;
+            break;
+        }
+    case SYSCALL_t::GET_SCHED_STATS:
+        {
+            // no destination means dump to the log instead
+            if (r->ebx && !kprepare_user_output(r->ebx, sizeof(sched_stats_t)))
+            {
+                r->eax = -1;
+                break;
+            }
+            if (r->ebx)
+            {
+                Scheduler::get_stats(reinterpret_cast<sched_stats_t*>(r->ebx));
+            }
+            else
+            {
+                Scheduler::log_stats();
+            }
+            r->eax = 0;
+            break;
+        }
+    case SYSCALL_t::GET_SCHED_REPORT:
+        {
+            if (!r->ebx || !kprepare_user_output(r->ebx, sizeof(sched_report_t)))
+            {
+                r->eax = -1;
+                break;
+            }
+            Scheduler::get_report(reinterpret_cast<sched_report_t*>(r->ebx));
+            r->eax = 0;
+            break;
+        }
+    case SYSCALL_t::GET_CACHE_STATS:
+        {
+            // no destination means dump to the log instead
+            if (r->ebx && !kprepare_user_output(r->ebx, sizeof(cache_stats_t)))
+            {
+                r->eax = -1;
+                break;
+            }
+            if (r->ebx)
+            {
+                block_cache().get_stats(reinterpret_cast<cache_stats_t*>(r->ebx));
+            }
+            else
+            {
+                block_cache().log_stats();
+            }
+            r->eax = 0;
+            break;
+        }
     default:
         {
             LOG("Unhandled Syscall: ", static_cast<u32>(r->eax));
@@ -22,6 +22,9 @@
 
 #include <stdlib.h>
 
+#include "alloc_stats.h"
+#include "sched_stats.h"
+#include "cache_stats.h"
 #include "event.h"
 #include "kernel.h"
 #include "keymaps/key_maps.h"
@@ -34,6 +37,76 @@ void div_0() {
         "div %eax");
 }
 
+void print_heap_stats() {
+    alloc_stats_t stats;
+    get_alloc_stats(&stats);
+    for (size_t i = 0; i < ALLOC_STATS_N_SLAB_CLASSES; i++) {
+        printf("slab %5u: %lu allocs %lu frees\n", 16u << i, stats.slab_allocs[i], stats.slab_frees[i]);
+    }
+    printf("slab pages: %lu\n", stats.slab_pages);
+    printf("chunks: %lu allocs %lu frees, %lu/%lu entries, %lu expansions\n", stats.chunk_allocs, stats.chunk_frees,
+           stats.chunks_in_use, stats.chunk_array_capacity, stats.chunk_array_expansions);
+    printf("live: %lu bytes peak: %lu bytes\n", stats.bytes_live, stats.bytes_peak);
+    printf("pages: %lu mapped %lu unmapped\n", stats.pages_mapped, stats.pages_unmapped);
+    printf("search: %llu ticks over %lu samples\n", stats.search_ticks, stats.search_samples);
+    const unsigned long zero_total = stats.zero_pool_hits + stats.zero_pool_misses;
+    printf("zeroed pool: %lu/%lu frames, %lu hits %lu misses (%lu%%)\n", stats.zero_pool_frames,
+           stats.zero_pool_capacity, stats.zero_pool_hits, stats.zero_pool_misses,
+           zero_total ? stats.zero_pool_hits * 100 / zero_total : 0);
+    printf("free frames: %lu\n", stats.phys_frames_free);
+}
+
+void print_sched_stats() {
+    sched_stats_t stats;
+    get_sched_stats(&stats);
+    const unsigned long long ticks_per_ms = stats.tsc_frequency / 1000 ? stats.tsc_frequency / 1000 : 1;
+    printf("uptime: %llu ms, idle: %llu ms (%llu%%)\n", stats.total_ticks / ticks_per_ms,
+           stats.idle_ticks / ticks_per_ms, stats.total_ticks ? stats.idle_ticks * 100 / stats.total_ticks : 0);
+    printf("timer interrupts: %lu, skipped while idle: %lu\n", stats.timer_interrupts, stats.ticks_skipped);
+    printf("idle entries: %lu, with no timer: %lu\n", stats.idle_entries, stats.tickless_entries);
+    printf("woken from idle by i/o: %lu\n", stats.io_wakeups);
+    printf("fpu traps: %lu, saves: %lu\n", stats.fpu_traps, stats.fpu_saves);
+}
+
+void print_cache_stats() {
+    cache_stats_t stats;
+    get_cache_stats(&stats);
+    const unsigned long total = stats.hits + stats.misses;
+    printf("block cache: %lu/%lu extents of %lu KiB\n", stats.used_extents, stats.capacity_extents,
+           stats.extent_bytes / 1024);
+    printf("hits: %lu misses: %lu (%lu%%)\n", stats.hits, stats.misses, total ? stats.hits * 100 / total : 0);
+    printf("evictions: %lu fills: %lu\n", stats.evictions, stats.fills);
+    printf("readahead: %lu extents, %lu read\n", stats.readahead_extents, stats.readahead_hits);
+}
+
+void print_top() {
+    sched_stats_t stats;
+    get_sched_stats(&stats);
+    // Large enough that it should not live on the stack.
+    static sched_report_t report;
+    get_sched_report(&report);
+    const unsigned long long ticks_per_ms = stats.tsc_frequency / 1000 ? stats.tsc_frequency / 1000 : 1;
+    const unsigned long long total = stats.total_ticks ? stats.total_ticks : 1;
+    printf("%4s %-16s %c %4s %5s %9s %9s %9s %7s %7s\n", "PID", "NAME", 'S', "PRI", "CPU%", "RUN ms", "IO ms",
+           "SLEEP ms", "PREEMPT", "YIELD");
+    for (unsigned long i = 0; i < report.n_processes; i++) {
+        const process_stats_t &p = report.processes[i];
+        printf("%4lu %-16.16s %c %4d %5llu %9llu %9llu %9llu %7lu %7lu\n", p.pid, p.name, p.state, p.priority,
+               p.run_ticks * 100 / total, p.run_ticks / ticks_per_ms, p.io_wait_ticks / ticks_per_ms,
+               p.sleep_ticks / ticks_per_ms, p.preemptions, p.yields);
+    }
+
+    static const char *trace_names[] = {"switch", "wake", "sleep", "io start", "io done"};
+    constexpr unsigned long n_shown = 16;
+    const unsigned long first = report.n_trace > n_shown ? report.n_trace - n_shown : 0;
+    printf("last %lu of %lu scheduler events:\n", report.n_trace - first, report.trace_total);
+    for (unsigned long i = first; i < report.n_trace; i++) {
+        const sched_trace_event_t &e = report.trace[i];
+        const unsigned long long us = e.tsc / (ticks_per_ms / 1000 ? ticks_per_ms / 1000 : 1);
+        printf("%12llu us  %-8s pid %u arg %lu\n", us, e.type < 5 ? trace_names[e.type] : "?", e.pid, e.arg);
+    }
+}
+
 BartShell::BartShell() {
     for (char &i: cmd_buffer) {
         i = 0;
@@ -172,6 +245,26 @@ int BartShell::process_cmd() {
         div_0();
         return 0;
     }
+    if (!strcmp("heap\0", cmd_buffer)) {
+        print_heap_stats();
+        return 0;
+    }
+    if (!strcmp("heap log\0", cmd_buffer)) {
+        get_alloc_stats(nullptr);
+        return 0;
+    }
+    if (!strcmp("sched\0", cmd_buffer)) {
+        print_sched_stats();
+        return 0;
+    }
+    if (!strcmp("cache\0", cmd_buffer)) {
+        print_cache_stats();
+        return 0;
+    }
+    if (!strcmp("top\0", cmd_buffer)) {
+        print_top();
+        return 0;
+    }
     FILE *f = fopen(cmd_buffer, "rb");
     if (f->handle > 0) {
         printf("executing %s\n", cmd_buffer);
@@ -211,11 +304,15 @@ int BartShell::process_cmd() {
             }
         }
         if (to_flush) { fflush(stdout); }
+        // Keys arrive at human speed so poll a few hundred times a second and let the CPU halt in between.
+        else { sleep_ms(5); }
     }
 }
 
 
 int main() {
+    // The shell is interactive so it should run ahead of anything it launches in the background.
+    set_priority(PRIORITY_CLASS_HIGH);
     // Init and load the shell. Shell draws directly to the terminal using printf
     auto shell = BartShell();
     shell.run();
@@ -593,8 +593,12 @@ MAX_RELEASE_CHECK_RATE   default: 4095 unless not HAVE_MMAP
 #define LACKS_SYS_PARAM_H
 #define LACKS_TIME_H
 
-// Use sblk to extend the heap to allocate more memory. Modern platforms use mmap but that's more complex.
-#define HAVE_MORECORE 0
+// Use sbrk to extend the per-process heap in 1 MiB steps and hand the top back once 4 MiB is unused. Requests above
+// the mmap threshold still get their own mapping.
+#define HAVE_MORECORE 1
+#define MORECORE_CONTIGUOUS 1
+#define DEFAULT_GRANULARITY ((size_t)1024U * (size_t)1024U)
+#define DEFAULT_TRIM_THRESHOLD ((size_t)4U * (size_t)1024U * (size_t)1024U)
 #define HAVE_MMAP 1
 #define MAP_ANONYMOUS 1
 
@@ -1574,7 +1578,7 @@ DLMALLOC_EXPORT int mspace_mallopt(int, int);
 #include <unistd.h>     /* for sbrk, sysconf */
 #else /* LACKS_UNISTD_H */
 // #if !defined(__FreeBSD__) && !defined(__OpenBSD__) && !defined(__NetBSD__)
-// extern void* sbrk(intptr_t increment);
+extern void* sbrk(intptr_t increment);
 // #endif /* FreeBSD etc */
 #endif /* LACKS_UNISTD_H */
 
@@ -0,0 +1,153 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "memory.h"
+#include "types.h"
+
+// Replays allocation patterns seen in the kernel. Each benchmark frees everything it allocates because the allocator
+// is a global singleton shared between them.
+
+static void init_once()
+{
+    static bool done = false;
+    if (done) return;
+    art_memory_init();
+    done = true;
+}
+
+// Level load in DOOM: lots of lump sized allocations which all go at once on level change.
+static void BM_DoomZoneTrace(benchmark::State& state)
+{
+    init_once();
+    std::mt19937 rng(1);
+    std::vector<size_t> sizes;
+    for (int i = 0; i < 2000; i++)
+    {
+        // mostly small thinkers and patches with the odd large texture or flat
+        const size_t kind = rng() % 10;
+        sizes.push_back(kind < 6 ? rng() % 256 + 16 : kind < 9 ? rng() % 4096 + 256 : rng() % 65536 + 4096);
+    }
+    std::vector<void*> ptrs(sizes.size());
+    for (auto _ : state)
+    {
+        for (size_t i = 0; i < sizes.size(); i++) ptrs[i] = art_alloc(sizes[i], 4);
+        // purge tags in roughly reverse order with some interleaving
+        for (size_t i = ptrs.size(); i-- > 0;) if (i % 3) art_free(ptrs[i]);
+        for (size_t i = 0; i < ptrs.size(); i += 3) art_free(ptrs[i]);
+    }
+    state.SetItemsProcessed(state.iterations() * sizes.size());
+}
+
+BENCHMARK(BM_DoomZoneTrace);
+
+// Mounting a file system: a tree of ArtFile/ArtDirectory objects, names and list nodes which live a long time.
+static void BM_FileTreeTrace(benchmark::State& state)
+{
+    init_once();
+    std::mt19937 rng(2);
+    std::vector<void*> ptrs;
+    ptrs.reserve(state.range(0) * 3);
+    for (auto _ : state)
+    {
+        for (int i = 0; i < state.range(0); i++)
+        {
+            ptrs.push_back(art_alloc(rng() % 2 ? 96 : 64, 4)); // file or directory object
+            ptrs.push_back(art_alloc(rng() % 48 + 8, 4)); // name
+            ptrs.push_back(art_alloc(16, 4)); // list node
+        }
+        state.PauseTiming();
+        for (void* ptr : ptrs) art_free(ptr);
+        ptrs.clear();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * 3);
+}
+
+BENCHMARK(BM_FileTreeTrace)->Arg(100)->Arg(10000);
+
+// Reads in flight: IO_read objects and their queue nodes created and destroyed in FIFO order alongside a read buffer.
+static void BM_IOReadChurn(benchmark::State& state)
+{
+    init_once();
+    constexpr size_t in_flight = 8;
+    void* ops[in_flight] = {};
+    void* nodes[in_flight] = {};
+    void* buffers[in_flight] = {};
+    size_t head = 0;
+    for (auto _ : state)
+    {
+        if (ops[head])
+        {
+            art_free(ops[head]);
+            art_free(nodes[head]);
+            art_free(buffers[head]);
+        }
+        ops[head] = art_alloc(48, 4);
+        nodes[head] = art_alloc(16, 4);
+        buffers[head] = art_alloc(8192, 4);
+        head = (head + 1) % in_flight;
+    }
+    for (size_t i = 0; i < in_flight; i++)
+    {
+        art_free(ops[i]);
+        art_free(nodes[i]);
+        art_free(buffers[i]);
+    }
+}
+
+BENCHMARK(BM_IOReadChurn);
+
+// Free then re-allocate one chunk while N others are live. Should stay flat as N grows. Each two page mapping holds a
+// 5000 byte chunk followed by the 3000 byte chunk being churned so no pages go back to kmunmap and only the allocator
+// itself is measured.
+static void BM_FreeLatency(benchmark::State& state)
+{
+    init_once();
+    std::vector<void*> anchors;
+    std::vector<void*> live;
+    for (int i = 0; i < state.range(0); i++)
+    {
+        anchors.push_back(art_alloc(5000, 4));
+        live.push_back(art_alloc(3000, 4));
+        if (anchors.back() == nullptr || live.back() == nullptr)
+        {
+            state.SkipWithError("out of memory setting up live chunks");
+            break;
+        }
+    }
+    size_t idx = 0;
+    for (auto _ : state)
+    {
+        art_free(live[idx]);
+        live[idx] = art_alloc(3000, 4);
+        idx = (idx + 7919) % live.size();
+    }
+    for (void* ptr : live) art_free(ptr);
+    for (void* ptr : anchors) art_free(ptr);
+}
+
+BENCHMARK(BM_FreeLatency)->RangeMultiplier(10)->Range(10, 100000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,163 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "alloc_stats.h"
+#include "art_alloc_fakes.h"
+#include "memory.h"
+#include "types.h"
+
+// The allocator is a global singleton so every test has to give back everything it allocates.
+
+class ArtAllocTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        art_memory_init();
+    }
+
+    static alloc_stats_t stats()
+    {
+        alloc_stats_t s;
+        art_alloc_get_stats(&s);
+        return s;
+    }
+};
+
+TEST_F(ArtAllocTest, SmallAllocationsAreReused)
+{
+    void* first = art_alloc(24);
+    ASSERT_NE(first, nullptr);
+    art_free(first);
+    void* second = art_alloc(20);
+    EXPECT_EQ(first, second);
+    art_free(second);
+}
+
+TEST_F(ArtAllocTest, AlignmentHonoured)
+{
+    std::vector<void*> ptrs;
+    for (size_t alignment = 1; alignment <= 16384; alignment <<= 1)
+    {
+        for (const size_t size : {1ul, 17ul, 100ul, 2000ul, 3000ul, 5000ul, 20000ul})
+        {
+            void* ptr = art_alloc(size, alignment);
+            ASSERT_NE(ptr, nullptr);
+            EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignment, 0) << "size " << size << " alignment " << alignment;
+            ptrs.push_back(ptr);
+        }
+    }
+    for (void* ptr : ptrs) art_free(ptr);
+}
+
+TEST_F(ArtAllocTest, NoOverlap)
+{
+    std::mt19937 rng(1234);
+    std::map<uintptr_t, std::pair<size_t, u8>> live; // start -> size, fill byte
+
+    auto check_and_free = [&live](const uintptr_t start)
+    {
+        const auto [size, fill] = live[start];
+        const auto* bytes = reinterpret_cast<const u8*>(start);
+        for (size_t i = 0; i < size; i++) ASSERT_EQ(bytes[i], fill) << "allocation at " << start << " was overwritten";
+        art_free(reinterpret_cast<void*>(start));
+        live.erase(start);
+    };
+
+    for (int i = 0; i < 20000; i++)
+    {
+        if (live.empty() || rng() % 3)
+        {
+            const size_t size = rng() % 2 ? rng() % 512 + 1 : rng() % 32768 + 1;
+            const size_t alignment = rng() % 4 ? 4 : 1 << rng() % 13;
+            auto* ptr = static_cast<u8*>(art_alloc(size, alignment));
+            ASSERT_NE(ptr, nullptr);
+            const auto start = reinterpret_cast<uintptr_t>(ptr);
+
+            const auto after = live.lower_bound(start);
+            if (after != live.end()) ASSERT_LE(start + size, after->first);
+            if (after != live.begin()) ASSERT_LE(std::prev(after)->first + std::prev(after)->second.first, start);
+
+            const u8 fill = rng();
+            std::memset(ptr, fill, size);
+            live[start] = {size, fill};
+        }
+        else
+        {
+            auto it = live.begin();
+            std::advance(it, rng() % live.size());
+            check_and_free(it->first);
+        }
+    }
+    while (!live.empty()) check_and_free(live.begin()->first);
+}
+
+TEST_F(ArtAllocTest, CoalescingRestoresWholePages)
+{
+    std::vector<size_t> sizes;
+    std::mt19937 rng(42);
+    for (int i = 0; i < 500; i++) sizes.push_back(rng() % 60000 + 2049);
+
+    auto run = [&sizes](const bool reverse)
+    {
+        std::vector<void*> ptrs;
+        for (const size_t size : sizes) ptrs.push_back(art_alloc(size));
+        if (reverse) std::reverse(ptrs.begin(), ptrs.end());
+        // free every other one first so that frees have to merge both ways
+        for (size_t i = 0; i < ptrs.size(); i += 2) art_free(ptrs[i]);
+        for (size_t i = 1; i < ptrs.size(); i += 2) art_free(ptrs[i]);
+    };
+
+    // the first pass can grow the chunk array and page map which are never given back
+    run(false);
+    const size_t pages_before = fake_pages_mapped();
+    const alloc_stats_t before = stats();
+    run(true);
+    const alloc_stats_t after = stats();
+
+    EXPECT_EQ(fake_pages_mapped(), pages_before);
+    EXPECT_EQ(after.pages_mapped - after.pages_unmapped, before.pages_mapped - before.pages_unmapped);
+    EXPECT_EQ(after.bytes_live, before.bytes_live);
+    EXPECT_EQ(after.chunks_in_use, before.chunks_in_use);
+}
+
+TEST_F(ArtAllocTest, StatsTrackLiveBytes)
+{
+    const alloc_stats_t before = stats();
+    void* small = art_alloc(100);
+    void* large = art_alloc(10000);
+    const alloc_stats_t during = stats();
+    EXPECT_EQ(during.slab_allocs[3], before.slab_allocs[3] + 1); // 128 byte class
+    EXPECT_EQ(during.chunk_allocs, before.chunk_allocs + 1);
+    EXPECT_GE(during.bytes_live, before.bytes_live + 128 + 10000);
+    EXPECT_GE(during.bytes_peak, during.bytes_live);
+    art_free(small);
+    art_free(large);
+    const alloc_stats_t after = stats();
+    EXPECT_EQ(after.bytes_live, before.bytes_live);
+    EXPECT_EQ(after.slab_frees[3], before.slab_frees[3] + 1);
+    EXPECT_EQ(after.chunk_frees, before.chunk_frees + 1);
+}
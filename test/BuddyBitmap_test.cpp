@@ -0,0 +1,140 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "BuddyBitmap.h"
+#include "types.h"
+
+constexpr size_t test_max_order = 10;
+constexpr size_t test_units = 1 << 16;
+
+class BuddyBitmapTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        storage.resize(BuddyBitmap<test_max_order>::storage_words(test_units));
+        buddy.init(storage.data(), test_units);
+    }
+
+    std::vector<u64> storage;
+    BuddyBitmap<test_max_order> buddy;
+};
+
+TEST_F(BuddyBitmapTest, StartsFullyAllocated)
+{
+    ASSERT_EQ(buddy.get_free_units(), 0);
+    ASSERT_EQ(buddy.alloc(0), BUDDY_ERR_IDX);
+}
+
+TEST_F(BuddyBitmapTest, SplitAndMergeRestoresLargestBlock)
+{
+    buddy.free_range(0, 1 << test_max_order);
+    ASSERT_EQ(buddy.get_free_units(), 1 << test_max_order);
+
+    std::vector<size_t> units;
+    for (size_t i = 0; i < (1 << test_max_order); i++)
+    {
+        const size_t unit = buddy.alloc(0);
+        ASSERT_EQ(unit, i); // lowest free unit first
+        units.push_back(unit);
+    }
+    ASSERT_EQ(buddy.alloc(0), BUDDY_ERR_IDX);
+
+    for (const size_t unit : units) ASSERT_TRUE(buddy.free(unit, 0));
+    ASSERT_EQ(buddy.alloc(test_max_order), 0);
+}
+
+TEST_F(BuddyBitmapTest, RunsAreContiguousAlignedAndTailIsReturned)
+{
+    buddy.free_range(0, test_units);
+    const size_t run = buddy.alloc_run(5);
+    ASSERT_NE(run, BUDDY_ERR_IDX);
+    ASSERT_EQ(run % 8, 0);
+    ASSERT_EQ(buddy.get_free_units(), test_units - 5);
+    for (size_t i = 0; i < 5; i++) ASSERT_FALSE(buddy.is_free(run + i));
+    ASSERT_TRUE(buddy.is_free(run + 5));
+
+    buddy.free_range(run, 5);
+    ASSERT_EQ(buddy.get_free_units(), test_units);
+    ASSERT_EQ(buddy.alloc(test_max_order), 0);
+}
+
+TEST_F(BuddyBitmapTest, DoubleFreeAndReserveAreRejected)
+{
+    buddy.free_range(0, 64);
+    const size_t unit = buddy.alloc(0);
+    ASSERT_TRUE(buddy.free(unit, 0));
+    ASSERT_FALSE(buddy.free(unit, 0));
+    ASSERT_FALSE(buddy.free(1, 1)); // misaligned
+
+    ASSERT_TRUE(buddy.reserve(37));
+    ASSERT_FALSE(buddy.reserve(37));
+    ASSERT_FALSE(buddy.is_free(37));
+    ASSERT_EQ(buddy.get_free_units(), 63);
+    for (size_t i = 0; i < 63; i++) ASSERT_NE(buddy.alloc(0), 37);
+    ASSERT_EQ(buddy.alloc(0), BUDDY_ERR_IDX);
+}
+
+TEST_F(BuddyBitmapTest, FreeRangeSkipsUnitsWhichAreAlreadyFree)
+{
+    buddy.free_range(10, 20);
+    buddy.free_range(0, 64);
+    ASSERT_EQ(buddy.get_free_units(), 64);
+    ASSERT_EQ(buddy.alloc(6), 0);
+}
+
+TEST_F(BuddyBitmapTest, RandomisedAgainstReference)
+{
+    buddy.free_range(0, test_units);
+    std::vector<bool> used(test_units, false);
+    std::vector<std::pair<size_t, size_t>> live;
+    std::mt19937 rng(7);
+    for (int i = 0; i < 20000; i++)
+    {
+        if (live.empty() || rng() % 3 != 0)
+        {
+            const size_t n = 1 + rng() % 40;
+            const size_t run = buddy.alloc_run(n);
+            if (run == BUDDY_ERR_IDX) continue;
+            for (size_t u = run; u < run + n; u++)
+            {
+                ASSERT_FALSE(used[u]);
+                used[u] = true;
+            }
+            live.emplace_back(run, n);
+        }
+        else
+        {
+            const size_t victim = rng() % live.size();
+            auto [run, n] = live[victim];
+            buddy.free_range(run, n);
+            for (size_t u = run; u < run + n; u++) used[u] = false;
+            live[victim] = live.back();
+            live.pop_back();
+        }
+    }
+    for (auto [run, n] : live) buddy.free_range(run, n);
+    ASSERT_EQ(buddy.get_free_units(), test_units);
+    ASSERT_EQ(buddy.alloc(test_max_order), 0);
+}
@@ -0,0 +1,85 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "DenseBooleanArray.h"
+
+// Same shape as the kernel virtual bitmap: 4GiB of 4KiB pages.
+constexpr size_t bench_bits = 0x100000;
+
+struct BitmapFixture
+{
+    explicit BitmapFixture(const bool summary) : array(bench_bits / 64), summary_array(
+                                                     DenseBooleanArray<u64>::summary_words(bench_bits))
+    {
+        dba = new DenseBooleanArray<u64>; // never deleted: the destructor would free array
+        dba->init(array.data(), bench_bits, false);
+        if (summary) dba->init_summary(summary_array.data());
+    }
+
+    std::vector<u64> array;
+    std::vector<u64> summary_array;
+    DenseBooleanArray<u64>* dba;
+};
+
+// Map is full apart from a short free run near the end, as it is after most of the address space has been handed out.
+static void BM_NextTrueMostlyFull(benchmark::State& state)
+{
+    BitmapFixture f(state.range(0));
+    f.dba->set_range(bench_bits - 100, bench_bits - 90, true);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(f.dba->get_next_true(0));
+    }
+}
+
+BENCHMARK(BM_NextTrueMostlyFull)->Arg(0)->Arg(1);
+
+// Fragmented free space: every 1000th page free, then one run large enough near the end.
+static void BM_NextTruesFragmented(benchmark::State& state)
+{
+    BitmapFixture f(state.range(0));
+    for (size_t i = 0; i < bench_bits - 1000; i += 1000) f.dba->set_bit(i, true);
+    f.dba->set_range(bench_bits - 512, bench_bits, true);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(f.dba->get_next_trues(0, 256));
+    }
+}
+
+BENCHMARK(BM_NextTruesFragmented)->Arg(0)->Arg(1);
+
+static void BM_SetRangeLarge(benchmark::State& state)
+{
+    BitmapFixture f(state.range(0));
+    bool b = true;
+    for (auto _ : state)
+    {
+        f.dba->set_range(3, bench_bits - 3, b);
+        b = !b;
+    }
+}
+
+BENCHMARK(BM_SetRangeLarge)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
@@ -19,6 +19,8 @@
 //
 #include <gtest/gtest.h>
 
+#include <vector>
+
 #include "DenseBooleanArray.h"
 #include "types.h"
 
@@ -149,3 +151,50 @@ TYPED_TEST(DenseBooleanArrayTest, set_data)
         ASSERT_EQ(my_dba[i], i >= start && i < end) << "first occurred when i = " << i << '\n';
     }
 }
+
+TYPED_TEST(DenseBooleanArrayTest, summary_matches_plain_search)
+{
+    constexpr size_t n_bits = 4000;
+    std::vector<TypeParam> plain_array(DenseBooleanArray<TypeParam>::summary_words(n_bits) * 64);
+    std::vector<TypeParam> summary_array(plain_array.size());
+    std::vector<u64> summary(DenseBooleanArray<TypeParam>::summary_words(n_bits));
+    const auto plain = new DenseBooleanArray<TypeParam>;
+    const auto summarised = new DenseBooleanArray<TypeParam>;
+    plain->init(plain_array.data(), n_bits, true);
+    summarised->init(summary_array.data(), n_bits, true);
+    summarised->init_summary(summary.data());
+
+    // mostly full map with a few holes and one long run
+    summarised->set_range(0, n_bits, false);
+    plain->set_range(0, n_bits, false);
+    for (const size_t i : {7, 300, 301, 1999, 3999})
+    {
+        plain->set_bit(i, true);
+        summarised->set_bit(i, true);
+    }
+    plain->set_range(2500, 2700, true);
+    summarised->set_range(2500, 2700, true);
+
+    for (size_t offset = 0; offset < n_bits; offset += 13)
+    {
+        ASSERT_EQ(summarised->get_next_true(offset), plain->get_next_true(offset)) << "offset " << offset;
+        ASSERT_EQ(summarised->get_next_false(offset), plain->get_next_false(offset)) << "offset " << offset;
+        ASSERT_EQ(summarised->get_next_trues(offset, 150), plain->get_next_trues(offset, 150)) << "offset " << offset;
+    }
+    ASSERT_EQ(summarised->get_next_true(8), 300);
+    ASSERT_EQ(summarised->get_next_trues(0, 2), 300);
+    ASSERT_EQ(summarised->get_next_trues(0, 200), 2500);
+    ASSERT_EQ(summarised->get_next_trues(0, 201), -1);
+    ASSERT_EQ(summarised->get_next_true(4000), -1);
+}
+
+TYPED_TEST(DenseBooleanArrayTest, search_stops_at_capacity)
+{
+    constexpr size_t n_bits = 70;
+    DenseBooleanArray<TypeParam> dba(n_bits, false);
+    ASSERT_EQ(dba.get_next_true(0), -1);
+    dba.set_all(true);
+    ASSERT_EQ(dba.get_next_false(0), -1);
+    ASSERT_EQ(dba.get_next_trues(0, n_bits), 0);
+    ASSERT_EQ(dba.get_next_trues(1, n_bits), -1);
+}
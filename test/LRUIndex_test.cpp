@@ -0,0 +1,142 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "LRUIndex.h"
+#include "types.h"
+
+class LRUIndexTest : public testing::Test
+{
+protected:
+    void make(const size_t n_slots)
+    {
+        storage.assign(LRUIndex::storage_bytes(n_slots) / sizeof(u64) + 1, 0);
+        index.init(storage.data(), n_slots);
+    }
+
+    std::vector<u64> storage;
+    LRUIndex index;
+};
+
+TEST_F(LRUIndexTest, FillsUnusedSlotsFirst)
+{
+    make(4);
+    bool evicted = true;
+    for (u64 k = 0; k < 4; k++)
+    {
+        ASSERT_NE(index.insert(k * 100, &evicted), LRU_ERR_IDX);
+        ASSERT_FALSE(evicted);
+    }
+    ASSERT_EQ(index.get_used(), 4);
+    for (u64 k = 0; k < 4; k++) ASSERT_NE(index.peek(k * 100), LRU_ERR_IDX);
+    ASSERT_EQ(index.peek(1), LRU_ERR_IDX);
+}
+
+TEST_F(LRUIndexTest, EvictsLeastRecentlyUsed)
+{
+    make(3);
+    const size_t a = index.insert(1);
+    index.insert(2);
+    index.insert(3);
+    ASSERT_EQ(index.find(1), a); // 2 is now the oldest
+    bool evicted = false;
+    index.insert(4, &evicted);
+    ASSERT_TRUE(evicted);
+    ASSERT_EQ(index.peek(2), LRU_ERR_IDX);
+    ASSERT_NE(index.peek(1), LRU_ERR_IDX);
+    ASSERT_NE(index.peek(3), LRU_ERR_IDX);
+    ASSERT_NE(index.peek(4), LRU_ERR_IDX);
+}
+
+TEST_F(LRUIndexTest, PeekDoesNotRefresh)
+{
+    make(2);
+    index.insert(1);
+    index.insert(2);
+    index.peek(1);
+    index.insert(3);
+    ASSERT_EQ(index.peek(1), LRU_ERR_IDX);
+    ASSERT_NE(index.peek(2), LRU_ERR_IDX);
+}
+
+TEST_F(LRUIndexTest, InsertExistingKeepsSlot)
+{
+    make(2);
+    const size_t slot = index.insert(7);
+    index.insert(8);
+    bool evicted = true;
+    ASSERT_EQ(index.insert(7, &evicted), slot);
+    ASSERT_FALSE(evicted);
+    ASSERT_EQ(index.get_used(), 2);
+}
+
+TEST_F(LRUIndexTest, ErasedSlotIsReusedFirst)
+{
+    make(3);
+    index.insert(1);
+    const size_t b = index.insert(2);
+    index.insert(3);
+    index.erase(b);
+    ASSERT_EQ(index.peek(2), LRU_ERR_IDX);
+    ASSERT_EQ(index.get_used(), 2);
+    bool evicted = true;
+    ASSERT_EQ(index.insert(4, &evicted), b);
+    ASSERT_FALSE(evicted);
+    ASSERT_NE(index.peek(1), LRU_ERR_IDX);
+}
+
+TEST_F(LRUIndexTest, CollidingKeysStayDistinct)
+{
+    make(64);
+    for (u64 k = 0; k < 64; k++) index.insert(k << 40 | k);
+    for (u64 k = 0; k < 64; k++) ASSERT_EQ(index.key_of(index.peek(k << 40 | k)), k << 40 | k);
+    for (u64 k = 0; k < 64; k += 2) index.erase(index.peek(k << 40 | k));
+    for (u64 k = 0; k < 64; k++) ASSERT_EQ(index.peek(k << 40 | k) == LRU_ERR_IDX, k % 2 == 0);
+}
+
+TEST_F(LRUIndexTest, NoSlots)
+{
+    make(0);
+    ASSERT_EQ(index.insert(1), LRU_ERR_IDX);
+    ASSERT_EQ(index.find(1), LRU_ERR_IDX);
+}
+
+TEST_F(LRUIndexTest, PinnedSlotsAreNotEvicted)
+{
+    make(2);
+    const size_t a = index.insert(1);
+    const size_t b = index.insert(2);
+    index.pin(a);
+    index.find(1);
+    bool evicted = false;
+    ASSERT_EQ(index.insert(3, &evicted), b);
+    ASSERT_TRUE(evicted);
+    ASSERT_EQ(index.peek(1), a);
+    index.pin(b);
+    ASSERT_EQ(index.insert(4), LRU_ERR_IDX);
+
+    index.unpin(a);
+    ASSERT_EQ(index.insert(4), a);
+    index.erase(b);
+    ASSERT_FALSE(index.is_pinned(b));
+    ASSERT_EQ(index.insert(5), b);
+}
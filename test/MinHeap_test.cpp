@@ -0,0 +1,107 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "MinHeap.h"
+#include "types.h"
+
+struct deadline_t
+{
+    u64 ticks;
+    size_t id;
+
+    bool operator<(const deadline_t& other) const { return ticks < other.ticks; }
+};
+
+TEST(MinHeapTest, PopsInAscendingOrder)
+{
+    MinHeap<u64, 16> heap;
+    for (const u64 v : {9, 3, 7, 1, 8, 2, 6, 4, 5, 0})
+    {
+        ASSERT_TRUE(heap.push(v));
+    }
+    for (u64 expected = 0; expected < 10; expected++)
+    {
+        ASSERT_EQ(heap.top(), expected);
+        heap.pop();
+    }
+    ASSERT_TRUE(heap.empty());
+}
+
+TEST(MinHeapTest, PushFailsWhenFull)
+{
+    MinHeap<u64, 4> heap;
+    for (u64 v = 0; v < 4; v++) ASSERT_TRUE(heap.push(v));
+    ASSERT_FALSE(heap.push(10));
+    ASSERT_EQ(heap.size(), 4);
+    heap.pop();
+    heap.pop(); // popping an empty heap is harmless
+    heap.pop();
+    heap.pop();
+    heap.pop();
+    ASSERT_TRUE(heap.empty());
+}
+
+TEST(MinHeapTest, RemoveIfKeepsHeapOrder)
+{
+    MinHeap<deadline_t, 64> heap;
+    for (size_t i = 0; i < 64; i++)
+    {
+        heap.push({static_cast<u64>((i * 37) % 64), i});
+    }
+    ASSERT_EQ(heap.remove_if([](const deadline_t& d) { return d.id % 3 == 0; }), 22);
+    ASSERT_EQ(heap.size(), 42);
+    u64 last = 0;
+    while (!heap.empty())
+    {
+        ASSERT_NE(heap.top().id % 3, 0);
+        ASSERT_GE(heap.top().ticks, last);
+        last = heap.top().ticks;
+        heap.pop();
+    }
+}
+
+TEST(MinHeapTest, MatchesSortedReference)
+{
+    MinHeap<u64, 512> heap;
+    std::vector<u64> reference;
+    std::mt19937 rng(17);
+    for (size_t step = 0; step < 20000; step++)
+    {
+        if (reference.size() < 512 && (reference.empty() || rng() % 3 != 0))
+        {
+            const u64 v = rng() % 1000;
+            ASSERT_TRUE(heap.push(v));
+            reference.push_back(v);
+        }
+        else
+        {
+            const auto smallest = std::min_element(reference.begin(), reference.end());
+            ASSERT_EQ(heap.top(), *smallest);
+            reference.erase(smallest);
+            heap.pop();
+        }
+        ASSERT_EQ(heap.size(), reference.size());
+    }
+}
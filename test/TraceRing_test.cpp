@@ -0,0 +1,61 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+#include <gtest/gtest.h>
+
+#include "TraceRing.h"
+#include "types.h"
+
+TEST(TraceRingTest, ReadsEverythingBeforeWrapping)
+{
+    TraceRing<u32, 8> ring;
+    for (u32 v = 0; v < 5; v++) ring.push(v);
+    u32 out[8] = {};
+    ASSERT_EQ(ring.read_latest(out, 8), 5);
+    for (u32 i = 0; i < 5; i++) ASSERT_EQ(out[i], i);
+    ASSERT_EQ(ring.total(), 5);
+}
+
+TEST(TraceRingTest, KeepsNewestOnceFull)
+{
+    TraceRing<u32, 8> ring;
+    for (u32 v = 0; v < 20; v++) ring.push(v);
+    u32 out[8] = {};
+    ASSERT_EQ(ring.read_latest(out, 8), 8);
+    for (u32 i = 0; i < 8; i++) ASSERT_EQ(out[i], 12 + i);
+    ASSERT_EQ(ring.total(), 20);
+}
+
+TEST(TraceRingTest, ReadsOnlyRequestedNewest)
+{
+    TraceRing<u32, 8> ring;
+    for (u32 v = 0; v < 6; v++) ring.push(v);
+    u32 out[3] = {};
+    ASSERT_EQ(ring.read_latest(out, 3), 3);
+    ASSERT_EQ(out[0], 3);
+    ASSERT_EQ(out[2], 5);
+}
+
+TEST(TraceRingTest, EmptyReadsNothing)
+{
+    const TraceRing<u32, 4> ring;
+    u32 out[4] = {};
+    ASSERT_EQ(ring.read_latest(out, 4), 0);
+    ASSERT_EQ(ring.total(), 0);
+}
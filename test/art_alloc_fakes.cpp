@@ -0,0 +1,112 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+#include "art_alloc_fakes.h"
+
+#include <cstring>
+#include <vector>
+#include <sys/mman.h>
+#include <x86intrin.h>
+
+#include "art_string.h"
+#include "paging.h"
+#include "TSC.h"
+
+static size_t pages_mapped = 0;
+
+// kmmap hands out the lowest free pages of one reserved arena, as the kernel does, so that addresses (and therefore
+// how many page map leaves the allocator needs) are the same on every run rather than depending on ASLR. 896MiB
+// covers the largest benchmark, which keeps about two pages per live chunk mapped, and still fits below the 2GiB
+// limit of MAP_32BIT.
+static constexpr size_t arena_pages = 0x38000;
+static u8* arena = nullptr;
+static std::vector<bool> arena_used;
+static size_t arena_hint = 0; // every page below this is in use, so the search starts here
+
+size_t fake_pages_mapped()
+{
+    return pages_mapped;
+}
+
+void* kmmap(uintptr_t, const size_t length, int, int, int, size_t)
+{
+    const size_t n_pages = (length + page_alignment - 1) / page_alignment;
+    if (arena == nullptr)
+    {
+        void* reserved = mmap(nullptr, arena_pages * page_alignment, PROT_NONE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT | MAP_NORESERVE, -1, 0);
+        if (reserved == MAP_FAILED) return nullptr;
+        arena = static_cast<u8*>(reserved);
+        arena_used.assign(arena_pages, false);
+    }
+    size_t start = arena_hint;
+    size_t run = 0;
+    for (size_t i = arena_hint; i < arena_pages && run < n_pages; i++)
+    {
+        if (arena_used[i])
+        {
+            run = 0;
+            start = i + 1;
+        }
+        else
+        {
+            run++;
+        }
+    }
+    if (run < n_pages) return nullptr;
+
+    void* ptr = mmap(arena + start * page_alignment, n_pages * page_alignment, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if (ptr == MAP_FAILED) return nullptr;
+    for (size_t i = start; i < start + n_pages; i++) arena_used[i] = true;
+    while (arena_hint < arena_pages && arena_used[arena_hint]) arena_hint++;
+    pages_mapped += n_pages;
+    return ptr;
+}
+
+int kmunmap(void* addr, const size_t length)
+{
+    const size_t n_pages = (length + page_alignment - 1) / page_alignment;
+    const size_t start = (static_cast<u8*>(addr) - arena) / page_alignment;
+    for (size_t i = start; i < start + n_pages; i++) arena_used[i] = false;
+    if (start < arena_hint) arena_hint = start;
+    pages_mapped -= n_pages;
+    // give the memory back but keep the range reserved
+    return mmap(addr, n_pages * page_alignment, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED | MAP_NORESERVE, -1,
+                0) == MAP_FAILED ? -1 : 0;
+}
+
+u64 TSC_get_ticks()
+{
+    return __rdtsc();
+}
+
+namespace art_string
+{
+    void* memcpy(void* dest, const void* src, const size_t n)
+    {
+        return std::memcpy(dest, src, n);
+    }
+
+    void* memset(void* s, const int c, const size_t n)
+    {
+        return std::memset(s, c, n);
+    }
+}
@@ -0,0 +1,32 @@
+// ArtOS - hobby operating system by Artie Poole
+// Copyright (C) 2025 Stuart Forbes Poole <artiepoole>
+//
+//     This program is free software: you can redistribute it and/or modify
+//     it under the terms of the GNU General Public License as published by
+//     the Free Software Foundation, either version 3 of the License, or
+//     (at your option) any later version.
+//
+//     This program is distributed in the hope that it will be useful,
+//     but WITHOUT ANY WARRANTY; without even the implied warranty of
+//     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//     GNU General Public License for more details.
+//
+//     You should have received a copy of the GNU General Public License
+//     along with this program.  If not, see <https://www.gnu.org/licenses/>
+
+//
+// Created by artiepoole on 10/18/26.
+//
+
+// Host stand-ins for the kernel functions art_alloc.cpp and art_slab.cpp link against. Pages come from mmap with
+// MAP_32BIT because the allocator's page map only covers a 32-bit address space.
+
+#ifndef ART_ALLOC_FAKES_H
+#define ART_ALLOC_FAKES_H
+
+#include "types.h"
+
+// Pages currently handed out by the fake kmmap
+size_t fake_pages_mapped();
+
+#endif //ART_ALLOC_FAKES_H